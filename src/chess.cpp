@@ -1,4 +1,5 @@
 #include <sstream>
+#include <thread>
 
 #include "./chess_game.h"
 #include "./chess_game_ter.h"
@@ -6,6 +7,8 @@ int main() {
   std::cout << WELCOME_MESSAGE << std::endl;
 
   std::string command;
+  // Set when a perft suite or the self tests fail, so scripts running them see it in the exit status
+  bool suite_failed = false;
 
   while (true) {
     if (!std::getline(std::cin, command)) break;
@@ -19,9 +22,28 @@ int main() {
       game.startUCI();
     } else if (cmd == "test") {
       ChessGame game;
+      // test [path_to_stockfish_executable] [workers]
       std::string path_to_file;
-      iss >> path_to_file;
-      game.testAgainstSF(path_to_file);
+      int num_workers = std::max(1, int(std::thread::hardware_concurrency()));
+      iss >> path_to_file >> num_workers;
+      game.testAgainstSF(path_to_file, std::max(1, num_workers));
+    } else if (cmd == "perftsuite") {
+      // perftsuite [path_to_epd_file] [max depth] [time budget in seconds] [threads]
+      std::string path_to_file;
+      int max_depth = MAX_DEPTH;
+      long long time_budget_s = 0;
+      int num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+      iss >> path_to_file >> max_depth >> time_budget_s >> num_threads;
+
+      ChessGame game;
+      if (!game.runPerftSuite(path_to_file, max_depth, time_budget_s * 1000, std::max(1, num_threads))) {
+        suite_failed = true;
+      }
+    } else if (cmd == "selftest") {
+      ChessGame game;
+      if (!game.runSelfTests()) {
+        suite_failed = true;
+      }
     } else if (cmd == "playgame") {
       ChessGameTER game;
       game.startGameTER();
@@ -35,5 +57,5 @@ int main() {
     }
   }
 
-  return 0;
+  return suite_failed ? 1 : 0;
 }
@@ -13,6 +13,7 @@ void ChessBoard::copyBoard() {
   color_copy = color;
   enpassant_copy = enpassant;
   castling_copy = castling;
+  hash_key_copy = hash_key;
 }
 
 void ChessBoard::revertBoard() {
@@ -24,6 +25,25 @@ void ChessBoard::revertBoard() {
   color = color_copy;
   enpassant = enpassant_copy;
   castling = castling_copy;
+  hash_key = hash_key_copy;
+}
+
+void ChessBoard::saveState(BoardState &state) {
+  memcpy(state.bitboards, bitboards, sizeof(state.bitboards));
+  memcpy(state.occupancy, occupancy, sizeof(state.occupancy));
+  state.color = color;
+  state.enpassant = enpassant;
+  state.castling = castling;
+  state.hash_key = hash_key;
+}
+
+void ChessBoard::restoreState(const BoardState &state) {
+  memcpy(bitboards, state.bitboards, sizeof(bitboards));
+  memcpy(occupancy, state.occupancy, sizeof(occupancy));
+  color = state.color;
+  enpassant = state.enpassant;
+  castling = state.castling;
+  hash_key = state.hash_key;
 }
 
 void ChessBoard::resetBoard() {
@@ -44,6 +64,8 @@ void ChessBoard::resetBoard() {
   castling = 0;
   castling_copy = 0;
   num_moves = 0;
+  hash_key = 0ULL;
+  hash_key_copy = 0ULL;
 }
 
 // =================================
@@ -73,6 +95,24 @@ bool ChessBoard::isThereCheck(int color) {
   return isSquareAttacked((color == white) ? bitScanForward(bitboards[WK]) : bitScanForward(bitboards[BK]), color ^ 1);
 }
 
+/**
+ * Returns all pieces of both colors attacking a square. Sliding attacks are calculated with the given
+ * occupancy instead of the board's, so removing pieces from it reveals x-ray attackers behind them.
+ *
+ * @param square; The attacked square.
+ * @param occupied; Occupancy bitboard used for blocking sliding pieces.
+ * @return Bitboard of all attacking pieces.
+ */
+U64 ChessBoard::attackersTo(int square, U64 occupied) {
+  U64 diagonal_sliders = bitboards[WB] | bitboards[BB] | bitboards[WQ] | bitboards[BQ];
+  U64 straight_sliders = bitboards[WR] | bitboards[BR] | bitboards[WQ] | bitboards[BQ];
+
+  return (pawn_attacks[black][square] & bitboards[WP]) | (pawn_attacks[white][square] & bitboards[BP]) |
+         (knight_attacks[square] & (bitboards[WN] | bitboards[BN])) |
+         (king_attacks[square] & (bitboards[WK] | bitboards[BK])) |
+         (getBishopMoves(square, occupied) & diagonal_sliders) | (getRooksMoves(square, occupied) & straight_sliders);
+}
+
 // =================================
 //          Board Setup
 // =================================
@@ -195,6 +235,35 @@ void ChessBoard::parseFEN(const char *fen) {
 
   // init all occupancies
   occupancy[both] = occupancy[white] | occupancy[black];
+
+  // init hash key
+  hash_key = generateHashKey();
+}
+
+/**
+ * Generates the Zobrist hash key of the position from scratch. During the search the key is
+ * updated incrementally in MakeMove().
+ *
+ * @return Hash key of the current position.
+ */
+U64 ChessBoard::generateHashKey() {
+  U64 key = 0ULL;
+
+  // Loop over piece bitboards
+  for (int piece = WP; piece <= BK; piece++) {
+    U64 bitboard = bitboards[piece];
+    while (bitboard) {
+      int square = bitScanForward(bitboard);
+      key ^= piece_keys[piece][square];
+      pop_bit(bitboard, square);
+    }
+  }
+
+  if (enpassant != no_sq) key ^= enpassant_keys[enpassant];
+  key ^= castle_keys[castling];
+  if (color == black) key ^= side_key;
+
+  return key;
 }
 
 // =================================
@@ -8,6 +8,14 @@
 
 #include "./chess_utils.h"
 
+// Board state saved before a move is made, so the move can be undone after deeper moves were made.
+struct BoardState {
+  U64 bitboards[12];
+  U64 occupancy[3];
+  unsigned int color, enpassant, castling;
+  U64 hash_key;
+};
+
 class ChessBoard {
  public:
   // Bitboards for each piece type and color and white/black/both occupancy
@@ -25,6 +33,9 @@ class ChessBoard {
   // Move counter
   unsigned int num_moves;
 
+  // Zobrist hash key of the position
+  U64 hash_key, hash_key_copy;
+
   // Default constructor
   ChessBoard() {
     // Initialize an empty board
@@ -36,15 +47,19 @@ class ChessBoard {
 
   // --- Board Setup ---
   void parseFEN(const char *fen);
+  U64 generateHashKey();
 
   // --- State Management ---
   void copyBoard();
   void revertBoard();
   void resetBoard();
+  void saveState(BoardState &state);
+  void restoreState(const BoardState &state);
 
   // --- Board and Move Analysis ---
   bool isSquareAttacked(int square, int side);
   bool isThereCheck(int color);
+  U64 attackersTo(int square, U64 occupied);
 
   // --- Board Visualization ---
   void printBitBoard(U64 bitboard); //DEBUG
@@ -1,9 +1,13 @@
 #include "./chess_game.h"
 
+#include "./numa.h"
+#include "./thread_pool.h"
+#include "./transposition_table.h"
+
 /**
  * Attempts to make a move on the chessboard, updating the game state accordingly.
  * - Checks if the move puts the own king in check, reverting the move if it's illegal.
- * - Updates bitboards, board's flags and move counter.
+ * - Updates bitboards, board's flags, hash key and move counter.
  *
  * @param move; An integer representing the move to be made.
  * @return Returns true (1) if the move is legal and successfully made, otherwise false (0).
@@ -28,6 +32,7 @@ bool ChessGame::MakeMove(int move) {
   // Update piece bitboards
   pop_bit(board.bitboards[piece], from_square);
   set_bit(board.bitboards[piece], to_square);
+  board.hash_key ^= piece_keys[piece][from_square] ^ piece_keys[piece][to_square];
 
   // Update occupancy bitboars
   color = (piece < 6) ? white : black;
@@ -40,6 +45,7 @@ bool ChessGame::MakeMove(int move) {
     for (int piece = range; piece < (range + 6); piece++) {
       if (get_bit(board.bitboards[piece], to_square)) {
         pop_bit(board.bitboards[piece], to_square);
+        board.hash_key ^= piece_keys[piece][to_square];
         break;
       }
     }
@@ -51,11 +57,18 @@ bool ChessGame::MakeMove(int move) {
   if (promoted) {
     pop_bit(board.bitboards[piece], to_square);
     set_bit(board.bitboards[promoted], to_square);
+    board.hash_key ^= piece_keys[piece][to_square] ^ piece_keys[promoted][to_square];
   }
 
   // On enpassant move, pop bit on row below/above from to_square
   if (enpassant) {
     (color == white) ? pop_bit(board.bitboards[BP], to_square + 8) : pop_bit(board.bitboards[WP], to_square - 8);
+    board.hash_key ^= (color == white) ? piece_keys[BP][to_square + 8] : piece_keys[WP][to_square - 8];
+  }
+
+  // Remove previous enpassant square from the hash key
+  if (board.enpassant != no_sq) {
+    board.hash_key ^= enpassant_keys[board.enpassant];
     board.enpassant = no_sq;
   }
 
@@ -65,21 +78,25 @@ bool ChessGame::MakeMove(int move) {
       case (g1):
         pop_bit(board.bitboards[WR], h1);
         set_bit(board.bitboards[WR], f1);
+        board.hash_key ^= piece_keys[WR][h1] ^ piece_keys[WR][f1];
         break;
       // W queen's side
       case (c1):
         pop_bit(board.bitboards[WR], a1);
         set_bit(board.bitboards[WR], d1);
+        board.hash_key ^= piece_keys[WR][a1] ^ piece_keys[WR][d1];
         break;
       // B king side
       case (g8):
         pop_bit(board.bitboards[BR], h8);
         set_bit(board.bitboards[BR], f8);
+        board.hash_key ^= piece_keys[BR][h8] ^ piece_keys[BR][f8];
         break;
       // B queen's side
       case (c8):
         pop_bit(board.bitboards[BR], a8);
         set_bit(board.bitboards[BR], d8);
+        board.hash_key ^= piece_keys[BR][a8] ^ piece_keys[BR][d8];
         break;
     }
   }
@@ -87,8 +104,10 @@ bool ChessGame::MakeMove(int move) {
   // ---- UPDATE ----
 
   // Update castling rights
+  board.hash_key ^= castle_keys[board.castling];
   board.castling &= CASTLING_RIGHTS[from_square];
   board.castling &= CASTLING_RIGHTS[to_square];
+  board.hash_key ^= castle_keys[board.castling];
 
   // Reset occupancy boards
   board.occupancy[white] = 0ULL;
@@ -114,12 +133,12 @@ bool ChessGame::MakeMove(int move) {
   // Update enpassant square if it is double pawn move
   if (double_p) {
     board.enpassant = (color == white) ? from_square - 8 : from_square + 8;
-  } else {
-    board.enpassant = no_sq;
+    board.hash_key ^= enpassant_keys[board.enpassant];
   }
 
   // Update color
   board.color = board.color ^ 1;
+  board.hash_key ^= side_key;
 
   // Update move counter
   board.num_moves += 1;
@@ -131,7 +150,9 @@ bool ChessGame::MakeMove(int move) {
 //        Perft Testing
 // ==============================
 
-void ChessGame::doPerftTest(unsigned int depth) { perftTest(depth, *this); }
+void ChessGame::doPerftTest(unsigned int depth, int num_threads, bool verify) {
+  perftTest(depth, *this, num_threads, verify);
+}
 
 // =====================================
 //   universal chess interface (UCI)
@@ -247,8 +268,8 @@ void ChessGame::parsePosition(const char *fen) {
  */
 void ChessGame::parseGo(const char *command) {
   // init parameters
-  int depth = 20;
-  int max_searched_depth = 20;
+  int depth = MAX_DEPTH;
+  int max_searched_depth = MAX_DEPTH;
 
   long long remaining_time_ms = Timer::DEFAULT_THINKING_TIME_MS;
   long long increment_time_ms = Timer::DEFAULT_INCREMENT_TIME_MS;
@@ -267,12 +288,21 @@ void ChessGame::parseGo(const char *command) {
     return;
   }
 
-  // Check for "perft" argument in command
+  // Check for "perft" argument in command, optionally followed by "threads [n]" (default: Threads option)
+  // and "verify" (make every move, also at the last ply), or by "stats" (leaf statistics by move type)
   argument = strstr(command, "perft");
   if (argument) {
     depth = atoi(argument + 6);
+    if (depth > 0 && strstr(command, "stats")) {
+      perftStatsTest(depth, *this);
+      return;
+    }
+    const char *threads_argument = strstr(command, "threads");
+    int num_threads = threads_argument ? atoi(threads_argument + 8) : threads.size();
+    num_threads = std::max(1, std::min(num_threads, ThreadPool::MAX_THREADS));
+    bool verify = strstr(command, "verify") != nullptr;
     if (depth > 0) {
-      doPerftTest(depth);  // Perform a perft test with the specified depth
+      doPerftTest(depth, num_threads, verify);  // Perform a perft test with the specified depth
     } else {
       std::cout << "Please specify a correct depth for the perft test.\n";
     }
@@ -297,11 +327,60 @@ void ChessGame::parseGo(const char *command) {
   }
 }
 
-
+/**
+ * Parses the "setoption" command from the UCI protocol input: "setoption name <id> value <x>".
+ * Supported options are listed in the response to the "uci" command.
+ *
+ * @param command; The input command string received from the UCI interface.
+ */
+void ChessGame::parseSetOption(const char *command) {
+  const char *name = strstr(command, "name ");
+  const char *value = strstr(command, "value ");
+  if (!name || !value) {
+    std::cout << "Invalid setoption command.\n";
+    return;
+  }
+  name += 5;
+  value += 6;
+
+  if (!strncmp(name, "MultiPV", 7)) {
+    multi_pv = std::max(1, std::min(atoi(value), MAX_MULTI_PV));
+  } else if (!strncmp(name, "Threads", 7)) {
+    threads.resize(std::max(1, std::min(atoi(value), ThreadPool::MAX_THREADS)));
+    // Spread the transposition table over the NUMA nodes of the new threads
+    if (numaNodes().size() > 1) {
+      tt.resize(tt.sizeMb());
+      std::cout << "info string " << threads.size() << " threads bound to " << numaNodes().size() << " NUMA nodes\n";
+    }
+  } else if (!strncmp(name, "Hash", 4)) {
+    int size_mb = std::max(1, std::min(atoi(value), int(TranspositionTable::MAX_SIZE_MB)));
+    if (!tt.resize(size_mb)) {
+      std::cout << "info string not enough memory for hash " << size_mb << " MB, keeping " << tt.sizeMb() << " MB\n";
+    }
+    std::cout << "info string hash " << tt.sizeMb() << " MB, " << tt.pageMode() << "\n";
+  } else if (!strncmp(name, "PerftHash", 9)) {
+    int size_mb = std::max(0, std::min(atoi(value), int(PerftHash::MAX_SIZE_MB)));
+    if (!perft_hash.resize(size_mb)) {
+      std::cout << "info string not enough memory for perft hash " << size_mb << " MB, keeping "
+                << perft_hash.sizeMb() << " MB\n";
+    }
+    if (perft_hash.enabled()) {
+      std::cout << "info string perft hash " << perft_hash.sizeMb() << " MB, " << perft_hash.pageMode() << "\n";
+    }
+  } else if (!strncmp(name, "LargePages", 10)) {
+    tt.setHugeTLB(!strncmp(value, "true", 4));
+    tt.resize(tt.sizeMb());
+    std::cout << "info string hash " << tt.sizeMb() << " MB, " << tt.pageMode() << "\n";
+  } else if (!strncmp(name, "Deterministic", 13)) {
+    deterministic = !strncmp(value, "true", 4);
+  } else {
+    std::cout << "Unknown option.\n";
+  }
+}
 
 /**
  * Initializes the Universal Chess Interface (UCI) protocol.
- * This function processes UCI commands:"isready", "ucinewgame", "position", "go", "help" and "quit".
+ * This function processes UCI commands:"isready", "ucinewgame", "position", "go", "setoption", "help" and "quit".
  * Also processes "print", which just prints current state of the board
  */
 void ChessGame::startUCI() {
@@ -330,8 +409,12 @@ void ChessGame::startUCI() {
       parsePosition(line);
     } else if (!strncmp(line, "ucinewgame", 10)) {
       parsePosition("position startpos\n");
+      tt.clear();
+      threads.run([](int) { clearHistory(); });
     } else if (!strncmp(line, "go", 2)) {
       parseGo(line);
+    } else if (!strncmp(line, "setoption", 9)) {
+      parseSetOption(line);
     } else if (!strncmp(line, "quit", 4)) {
       break;
     } else if (!strncmp(line, "uci", 3)) {
@@ -10,12 +10,17 @@
 #include "./perft.h"
 #include "./chess_timer.h"
 
+// Defined in evaluation.cpp
+void initReductions();
+
 class ChessGame {
  public:
   ChessBoard board;
   Moves moves;
   bool file_output;  // for running tests
   int best_move;
+  int multi_pv;  // Number of best lines searched and reported (UCI option MultiPV)
+  bool deterministic;  // Multithreaded searches are reproducible (UCI option Deterministic)
 
   Timer timer;
   // Constructor
@@ -25,11 +30,15 @@ class ChessGame {
   ChessGame(const char *fen) {
     initLeapersAttacks();
     initGenerateRays();
+    initZobristKeys();
+    initReductions();
 
     board.parseFEN(fen);
 
     this->board = board;
     this->file_output = false;
+    this->multi_pv = 1;
+    this->deterministic = false;
   }
 
   // --- Print Board ---
@@ -47,15 +56,18 @@ class ChessGame {
   void startUCI();
 
   // --- testing ---
-  void testAgainstSF(std::string &path_to_sf);
+  void testAgainstSF(std::string &path_to_sf, int num_workers);
+  bool runPerftSuite(const std::string &file_path, int max_depth, long long time_budget_ms, int num_threads);
+  bool runSelfTests();
 
   // --- Perft testing ---
-  void doPerftTest(unsigned int depth);
+  void doPerftTest(unsigned int depth, int num_threads, bool verify);
 
   // --- UCI ---
   void parsePosition(const char *fen);
   int parseMove(const char *ptrChar);
   void parseGo(const char *command);
+  void parseSetOption(const char *command);
 };
 
 #endif  // CHESS_GAME_H_
\ No newline at end of file
@@ -1,5 +1,5 @@
 #include <algorithm>
-#include <cstdlib>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -10,6 +10,9 @@
 #include <vector>
 
 #include "./chess_game.h"
+#include "./engine_process.h"
+#include "./thread_pool.h"
+#include "./transposition_table.h"
 
 // ======================
 //        TESTING
@@ -47,23 +50,6 @@ struct PerftResult {
   bool operator>(const PerftResult &other) const { return num_nodes > other.num_nodes; }
 };
 
-std::string ensureCorrectPathFormat(std::string &path) {
-  std::string correctedPath;
-  for (size_t i = 0; i < path.length(); ++i) {
-    if (path[i] == '\\') {
-      // Append an extra backslash to escape it correctly
-      correctedPath += "\\\\";
-      // If the next character is also a backslash, skip it to avoid doubling again
-      if (i + 1 < path.length() && path[i + 1] == '\\') {
-        i++;
-      }
-    } else {
-      correctedPath += path[i];
-    }
-  }
-  return correctedPath;
-}
-
 void printPerftResults(const std::vector<PerftResult> &results) {
   std::cout << "___________________________________________\n";
   std::cout << "PERFT RESULTS FOR ENGINE: " << engines_str[results[0].engine] << "\n\n";
@@ -140,110 +126,117 @@ std::vector<CommandsBlock> parseCommandsBlocks(const std::string &filePath) {
 }
 
 /**
- * Parses a series of chess position analysis commands and executes them using the Stockfish engine.
- * It captures the output, specifically the performance test (Perft) results, and organizes them into a structured
- * format.
+ * Checks if a line of reference engine output is a move with its node count, e.g. "e7e8q: 12". Other lines
+ * with a colon (info strings, timing) are skipped.
  *
- * @param blocks; Vector of CommandsBlock, each representing a set of commands for analyzing specific positions.
- * @return Vector of PerftResult, containing results of the performance tests for each command block.
+ * @param line; Line of engine output.
+ * @return true for a move:nodes line.
  */
-std::vector<PerftResult> parsePerftResultsSF(std::vector<CommandsBlock> blocks, std::string path_to_stockfish) {
-  // Init an empty vector to hold the Perft results.
-  std::vector<PerftResult> results_array;
-  // Declare a variable to store the current result.
-  PerftResult currentResult;
+static bool isMoveNodesLine(const std::string &line) {
+  size_t colon = line.find(':');
+  if (colon != 4 && colon != 5) return false;
+  return line[0] >= 'a' && line[0] <= 'h' && line[1] >= '1' && line[1] <= '8' && line[2] >= 'a' && line[2] <= 'h' &&
+         line[3] >= '1' && line[3] <= '8';
+}
 
-  // Iterate over each command block provided as input.
+/**
+ * Runs one perft command on a running reference engine and parses the move breakdown streamed back,
+ * up to the "Nodes searched" line.
+ *
+ * @param engine; The reference engine process.
+ * @param block; Block holding the position command.
+ * @param cmd; The 'go perft' command.
+ * @param result; Set to the parsed result.
+ * @return false if the engine exited before reporting the nodes searched.
+ */
+static bool runPerftSF(EngineProcess &engine, const CommandsBlock &block, const std::string &cmd,
+                       PerftResult &result) {
+  if (!engine.send(block.position) || !engine.send(cmd)) {
+    return false;
+  }
+
+  // Extract the position/FEN and the depth
+  auto pos = block.position.find("fen");
+  result.fen = (pos != std::string::npos) ? block.position.substr(pos + 4) : "startpos";
+  result.depth = std::stoi(cmd.substr(cmd.find_last_of(" ") + 1));
+  result.engine = stockfish;
+
+  std::string line;
+  while (engine.readLine(line)) {
+    if (line.find("Nodes searched") != std::string::npos) {
+      std::istringstream iss(line.substr(line.find(':') + 1));
+      iss >> result.num_nodes;
+      return true;
+    } else if (isMoveNodesLine(line)) {
+      result.move_node.push_back(parseMoveAndNodes(line));
+    }
+  }
+  return false;
+}
+
+/**
+ * Executes the perft commands of all blocks on the Stockfish engine and collects the results. Every worker
+ * thread owns one long lived engine process and streams commands and results through its pipes, the workers
+ * take the commands from a shared counter.
+ *
+ * @param blocks; Vector of CommandsBlock, each representing a set of commands for analyzing specific positions.
+ * @param path_to_stockfish; Path to the Stockfish executable.
+ * @param num_workers; Number of engine processes run in parallel.
+ * @param results_array; Filled with the PerftResults in the order of the commands, without the commands that failed.
+ * @return false if no engine process could be started.
+ */
+bool parsePerftResultsSF(const std::vector<CommandsBlock> &blocks, const std::string &path_to_stockfish,
+                         int num_workers, std::vector<PerftResult> &results_array) {
+  // One job per 'go perft' command
+  std::vector<std::pair<const CommandsBlock *, const std::string *>> jobs;
   for (const auto &block : blocks) {
     for (const auto &cmd : block.go_depth) {
-      // Open a temporary file for writing commands, truncating it first if it exists.
-      std::ofstream fileCommandTemp(COMMANDS_FILE_TEMP, std::ofstream::out | std::ofstream::trunc);
-      if (!fileCommandTemp.is_open()) {
-        std::cerr << "Error: Failed to open temporary command file for writing: " << COMMANDS_FILE_TEMP << std::endl;
-        // Continuing to the next command block if unable to open the file
-        continue;
-      }
-
-      // Write the position and command to the temporary file, then close it.
-      fileCommandTemp << block.position + "\n";
-      fileCommandTemp << cmd + "\n";
-      fileCommandTemp << "quit\n";  // Ensuring Stockfish exits after processing the command
-      fileCommandTemp.close();
-      // std::cout << "Commands written to " << COMMANDS_FILE_TEMP << " and file closed." << std::endl;
-
-      // Construct the command string to execute Stockfish with input and output redirection.
-      std::string command;
-      // clang-format off
-      #ifdef _WIN32
-        // For Windows systems
-        command = path_to_stockfish + " < " + COMMANDS_FILE_TEMP + " > " + OUTPUT_FILE_SF;
-      #else
-        // For Unix-based systems (Linux, macOS)
-        command = "./"+ path_to_stockfish +" < " + COMMANDS_FILE_TEMP + " > " + OUTPUT_FILE_SF;
-      #endif
-      // clang-format on
-
-      // Execute the command in the system shell.
-      int result = system(command.c_str());
-
-      // Immediately attempt to delete the temporary command file
-      if (std::remove(COMMANDS_FILE_TEMP.c_str()) != 0) {
-        std::cerr << "Warning: Failed to delete temporary command file: " << COMMANDS_FILE_TEMP << std::endl;
-      }
-      // else {
-      //   std::cout << "Temporary command file " << COMMANDS_FILE_TEMP << " deleted successfully." << std::endl;
-      // }
-
-      if (result != 0) {
-        std::cerr << "Error: Command execution failed with return code " << result << std::endl;
-        // Skip parsing and move to the next command if execution failed
-        continue;
-      }
+      jobs.emplace_back(&block, &cmd);
+    }
+  }
+  num_workers = std::max(1, std::min({num_workers, int(jobs.size()), ThreadPool::MAX_THREADS}));
+
+  // Engines are started one at a time, before any worker runs (see EngineProcess::start)
+  std::vector<EngineProcess> engines(num_workers);
+  int started = 0;
+  while (started < num_workers) {
+    EngineProcess &engine = engines[started];
+    if (!engine.start(path_to_stockfish) || !engine.send("isready") || !engine.waitFor("readyok")) {
+      engine.stop();
+      break;
+    }
+    started++;
+  }
+  if (!started) {
+    std::cout << "Error: Failed to start the engine: " << path_to_stockfish << std::endl;
+    return false;
+  }
 
-      // Extract the position/FEN and assign
-      auto pos = block.position.find("fen");
-      currentResult.fen = (pos != std::string::npos) ? block.position.substr(pos + 4) : "startpos";
-
-      // Assign DEPTH
-      std::string numberStr = cmd.substr(cmd.find_last_of(" ") + 1);
-      int depth = std::stoi(numberStr);
-      currentResult.depth = depth;
-
-      // assign MOVES AND NUM_NODES
-      std::ifstream fileResults(OUTPUT_FILE_SF);
-      std::string line;
-      if (!fileResults.is_open()) {
-        std::cerr << "Error: Failed to open Stockfish output file for reading: " + OUTPUT_FILE_SF << std::endl;
-        // Skip this result and continue to the next if unable to read results
-        continue;
-      }
-      while (std::getline(fileResults, line)) {
-        // If a line contains "Nodes searched", parse and set the number of nodes.
-        if (line.find("Nodes searched") != std::string::npos) {
-          std::istringstream iss(line);
-          std::string move;
-          std::string separator;  // for the colon
-          int nodes;
-
-          iss >> move >> separator >> nodes;
-          currentResult.num_nodes = nodes;
-
-        } else if (line.find(":") != std::string::npos) {
-          // If a line contains a colon, it's assumed to be a move, parse it accordingly.
-          currentResult.move_node.push_back(parseMoveAndNodes(line));
-        }
+  std::vector<PerftResult> job_results(jobs.size());
+  std::vector<char> job_done(jobs.size(), false);
+  std::atomic<int> next_job(0);
+
+  // A worker stops when its engine exits, the other workers take over the remaining jobs.
+  // The workers run on the search thread pool.
+  threads.run([&](int worker_id) {
+    int i;
+    while ((i = next_job++) < int(jobs.size())) {
+      if (!runPerftSF(engines[worker_id], *jobs[i].first, *jobs[i].second, job_results[i])) {
+        break;
       }
-      // Add the current result to the results array and reset it for the next iteration.
-      currentResult.engine = stockfish;
-      results_array.push_back(currentResult);
-      currentResult = PerftResult();
+      job_done[i] = true;
+    }
+  }, started);
 
-      // Close the output file.
-      fileResults.close();
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (job_done[i]) {
+      results_array.push_back(job_results[i]);
+    } else {
+      std::cerr << "Error: The engine did not finish '" << *jobs[i].second << "' for '" << jobs[i].first->position
+                << "'" << std::endl;
     }
   }
-
-  return results_array;
+  return true;
 }
 
 /**
@@ -404,8 +397,9 @@ bool comparePerftResults(const std::vector<PerftResult> &array1, const std::vect
  * with this chess engine's Perft results.
  *
  * @param path_to_sf; String reference containing the path to the Stockfish executable.
+ * @param num_workers; Number of Stockfish processes run in parallel.
  */
-void ChessGame::testAgainstSF(std::string &path_to_sf) {
+void ChessGame::testAgainstSF(std::string &path_to_sf, int num_workers) {
   namespace fs = std::filesystem;
   fs::path pathObj(path_to_sf);
   // Check if the path exists and is a regular file
@@ -414,22 +408,28 @@ void ChessGame::testAgainstSF(std::string &path_to_sf) {
     return;
   }
 
+#ifdef _WIN32
   if (pathObj.extension() != ".exe") {
     std::cout << "Error: The specified file does not have a .exe extension." << std::endl;
     return;
   }
+#endif
 
   // Start ANALYSIS
   std::cout << "Analysing ... (if there are some big depths it can take a while (forever))." << std ::endl;
-  // Flag property of ChessGame, indicating that output will be directed to file not terminal
-  file_output = true;
-
-  // Ensure correct path format (double backslash)
-  std::string path_to_stockfish = ensureCorrectPathFormat(path_to_sf);
 
   // Parse the command blocks (from commands.txt)
   std::vector<CommandsBlock> blocks = parseCommandsBlocks(COMMANDS_FILE);
 
+  // Obtain the Perft results from the Stockfish engine first, there is nothing to compare with if it doesn't start
+  std::vector<PerftResult> results_lb;
+  if (!parsePerftResultsSF(blocks, path_to_sf, num_workers, results_lb)) {
+    return;
+  }
+
+  // Flag property of ChessGame, indicating that output will be directed to file not terminal
+  file_output = true;
+
   // Iterate over each commands block, executing the contained Perft tests.
   for (const auto &block : blocks) {
     // Append the current position to the output file.
@@ -447,9 +447,6 @@ void ChessGame::testAgainstSF(std::string &path_to_sf) {
   // Remove the output file as it's no longer needed.
   std::remove(OUTPUT_FILE_LB.c_str());
 
-  // Obtain the Perft results from the Stockfish engine for comparison
-  auto results_lb = parsePerftResultsSF(blocks, path_to_stockfish);
-
   // DEBUG
   // results_lb[0].move_node.push_back(std::make_pair("f4f4", 999));
   // results_lb[0].num_nodes = 99;
@@ -459,10 +456,355 @@ void ChessGame::testAgainstSF(std::string &path_to_sf) {
   // printPerftResults(results_lb);
 
   // Print success if there are no diff
-  if (comparePerftResults(results_sf, results_lb)) {
+  if (!results_sf.empty() && comparePerftResults(results_sf, results_lb)) {
     std::cout << "Success: All " << results_sf.size() << " Perft tests are consistent between engines "
               << engines_str[results_lb[0].engine] << " and " << engines_str[results_sf[0].engine] << std::endl;
   }
 
   file_output = false;
-}
\ No newline at end of file
+}
+
+/**
+ * Position of a perft suite with the expected node counts from its EPD line, and the results of its run.
+ */
+struct PerftSuiteEntry {
+  std::string fen;
+  std::vector<std::pair<int, U64>> expected;  // Depth and expected node count, in the order of the EPD line
+  std::vector<std::pair<int, U64>> failed;    // Depth and wrong node count of the failed depths
+  int depths_passed = 0;
+  int depths_skipped = 0;
+  U64 nodes = 0;
+};
+
+/**
+ * Parses an EPD perft suite. Every line holds a FEN followed by the expected counts, e.g.
+ * "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400 ;D3 8902".
+ * Empty lines and lines starting with '#' are skipped.
+ *
+ * @param file_path; Path to the EPD file.
+ * @return Suite positions, in file order.
+ */
+std::vector<PerftSuiteEntry> parsePerftSuite(const std::string &file_path) {
+  std::vector<PerftSuiteEntry> entries;
+  std::ifstream file(file_path);
+  std::string line;
+
+  while (std::getline(file, line)) {
+    size_t separator = line.find(';');
+    if (line.empty() || line[0] == '#' || separator == std::string::npos) continue;
+
+    PerftSuiteEntry entry;
+    entry.fen = line.substr(0, separator);
+    entry.fen.erase(entry.fen.find_last_not_of(" \t") + 1);
+
+    std::istringstream counts(line.substr(separator));
+    std::string field;
+    while (std::getline(counts, field, ';')) {
+      std::istringstream fieldStream(field);
+      std::string name;
+      U64 nodes;
+      if (fieldStream >> name >> nodes && name.size() > 1 && name[0] == 'D') {
+        entry.expected.emplace_back(std::stoi(name.substr(1)), nodes);
+      }
+    }
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+/**
+ * Runs a perft suite from an EPD file without any external engine. The positions are spread over the
+ * threads, every position checks its expected counts from the shallowest depth on. Depths above max_depth
+ * are skipped, and so are the depths not yet started when the time budget runs out.
+ * Prints the failed depths of every position and a summary with the aggregate nodes per second.
+ *
+ * @param file_path; Path to the EPD file.
+ * @param max_depth; Deepest depth checked.
+ * @param time_budget_ms; Time after which no new depth is started (0 = no limit).
+ * @param num_threads; Number of threads running the positions.
+ * @return true if no depth failed.
+ */
+bool ChessGame::runPerftSuite(const std::string &file_path, int max_depth, long long time_budget_ms,
+                              int num_threads) {
+  std::vector<PerftSuiteEntry> entries = parsePerftSuite(file_path);
+  if (entries.empty()) {
+    std::cout << "Error: No perft positions found in " << file_path << "." << std::endl;
+    return false;
+  }
+
+  // Games are set up before the threads start, the constructor initializes the shared tables
+  std::vector<ChessGame> games;
+  for (const auto &entry : entries) {
+    games.emplace_back(entry.fen.c_str());
+  }
+
+  num_threads = std::max(1, std::min(num_threads, ThreadPool::MAX_THREADS));
+  std::cout << "Running " << entries.size() << " perft positions on " << num_threads << " threads ..." << std::endl;
+  long start = getTimeMs();
+  std::atomic<int> next_entry(0);
+
+  // Positions are counted on the search thread pool
+  threads.run([&](int) {
+    std::vector<SearchStack> stack(MAX_PLY);
+    int i;
+    while ((i = next_entry++) < int(entries.size())) {
+      PerftSuiteEntry &entry = entries[i];
+      for (const auto &expected : entry.expected) {
+        bool out_of_time = time_budget_ms && getTimeMs() - start > time_budget_ms;
+        if (expected.first > max_depth || out_of_time) {
+          entry.depths_skipped++;
+          continue;
+        }
+
+        U64 nodes = perft(expected.first, games[i], stack.data(), false);
+        entry.nodes += nodes;
+        if (nodes == expected.second) {
+          entry.depths_passed++;
+        } else {
+          entry.failed.emplace_back(expected.first, nodes);
+        }
+      }
+    }
+  }, num_threads);
+  long time_ms = std::max(getTimeMs() - start, 1L);
+
+  // Report the failures per position, then the summary
+  int passed = 0, failed = 0, skipped = 0;
+  U64 nodes = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PerftSuiteEntry &entry = entries[i];
+    passed += entry.depths_passed;
+    failed += int(entry.failed.size());
+    skipped += entry.depths_skipped;
+    nodes += entry.nodes;
+
+    for (const auto &failure : entry.failed) {
+      U64 expected = 0;
+      for (const auto &count : entry.expected) {
+        if (count.first == failure.first) expected = count.second;
+      }
+      std::cout << "FAIL position " << i + 1 << " (" << entry.fen << ") depth " << failure.first << ": expected "
+                << expected << ", got " << failure.second << "\n";
+    }
+  }
+
+  std::cout << "\nPerft suite " << (failed ? "FAILED" : "PASSED") << ": " << passed << " passed, " << failed
+            << " failed, " << skipped << " skipped\n"
+            << "Nodes: " << nodes << "  Time: " << time_ms << " ms  NPS: " << nodes * 1000 / time_ms << "\n"
+            << std::endl;
+  return failed == 0;
+}
+
+// ======================
+//      SELF TESTS
+// ======================
+
+/**
+ * Checks that the parallel perft split reaches every root move. With 20 tasks wanted per root move of the start
+ * position, every root move must be split, and the split tasks must count the same nodes as a plain perft.
+ *
+ * @param error; Set to the reason of a failure.
+ * @return true if the test passed.
+ */
+static bool testPerftSplit(std::string &error) {
+  const int depth = 4;
+  const U64 expected_nodes = 197281;
+  ChessGame game;
+
+  std::vector<PerftTask> tasks;
+  perftRootTasks(game, tasks, depth);
+  int num_root_moves = int(tasks.size());
+  splitPerftTasks(game, tasks, depth, num_root_moves * 20);
+
+  for (const PerftTask &task : tasks) {
+    if (task.length == 1) {
+      int move = game.moves.moves[task.root_index];
+      error = std::string("root move ") + square_to_position[game.moves.get_move_source(move)] +
+              square_to_position[game.moves.get_move_target(move)] + " was not split (" +
+              std::to_string(tasks.size()) + " tasks)";
+      return false;
+    }
+  }
+
+  U64 root_nodes[256] = {};
+  runPerftTasks(game, tasks, depth, 2, false, root_nodes);
+  U64 nodes = 0;
+  for (int i = 0; i < 256; i++) {
+    nodes += root_nodes[i];
+  }
+  if (nodes != expected_nodes) {
+    error = "split tasks counted " + std::to_string(nodes) + " nodes, expected " + std::to_string(expected_nodes);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Checks the aspiration windows of MultiPV lines that swap order between iterations. In the Kiwipete position
+ * the second and third line swap at depth 2 and the first and second at depth 9. Every line starts with the
+ * move expected to take it and its window is centred on that move's previous score, so a line after the first
+ * may miss its window only once (its score jumps at depth 4). The lines must be distinct moves, best first.
+ *
+ * @param error; Set to the reason of a failure.
+ * @return true if the test passed.
+ */
+static bool testMultiPVSwap(std::string &error) {
+  const int depth = 9;
+  const int num_lines = 3;
+  ChessGame game("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+  game.multi_pv = num_lines;
+  tt.clear();
+  threads.run([](int) { clearHistory(); });
+
+  std::stringstream output;
+  std::streambuf *stdout_buffer = std::cout.rdbuf(output.rdbuf());
+  game.parseGo(("go depth " + std::to_string(depth)).c_str());
+  std::cout.rdbuf(stdout_buffer);
+
+  // First move and score of every line by depth, and how often each line missed its window
+  std::vector<std::vector<std::pair<std::string, int>>> lines(depth + 1);
+  int window_misses[num_lines + 1] = {};
+  std::string line;
+  while (std::getline(output, line)) {
+    std::istringstream tokens(line);
+    std::string token, move;
+    int multipv = 0, line_depth = 0, score = 0;
+    bool bound = false;
+    while (tokens >> token) {
+      if (token == "multipv") {
+        tokens >> multipv;
+      } else if (token == "cp") {
+        tokens >> score;
+      } else if (token == "mate") {
+        // Sooner mates first, as with the scores in centipawns
+        tokens >> score;
+        score = (score > 0) ? INFINITY_SCORE - score : -INFINITY_SCORE - score;
+      } else if (token == "lowerbound" || token == "upperbound") {
+        bound = true;
+      } else if (token == "depth") {
+        tokens >> line_depth;
+      } else if (token == "pv") {
+        tokens >> move;
+        break;
+      }
+    }
+    if (multipv < 1 || multipv > num_lines || line_depth < 1 || line_depth > depth) {
+      continue;
+    }
+    if (bound) {
+      window_misses[multipv]++;
+    } else if (multipv == int(lines[line_depth].size()) + 1) {
+      lines[line_depth].emplace_back(move, score);
+    } else {
+      error = "line " + std::to_string(multipv) + " of depth " + std::to_string(line_depth) + " out of order";
+      return false;
+    }
+  }
+
+  bool swapped = false;
+  for (int d = 1; d <= depth; d++) {
+    if (int(lines[d].size()) != num_lines) {
+      error = "depth " + std::to_string(d) + " reported " + std::to_string(lines[d].size()) + " lines";
+      return false;
+    }
+    for (int i = 1; i < num_lines; i++) {
+      if (lines[d][i].second > lines[d][i - 1].second) {
+        error = "line " + std::to_string(i + 1) + " of depth " + std::to_string(d) + " scores above line " +
+                std::to_string(i);
+        return false;
+      }
+      for (int j = 0; j < i; j++) {
+        if (lines[d][i].first == lines[d][j].first) {
+          error = "move " + lines[d][i].first + " is in two lines of depth " + std::to_string(d);
+          return false;
+        }
+      }
+    }
+    // A move of the previous depth that took another line
+    for (int i = 0; i < num_lines && d > 1; i++) {
+      for (int j = 0; j < num_lines; j++) {
+        swapped |= i != j && lines[d][i].first == lines[d - 1][j].first;
+      }
+    }
+  }
+  if (!swapped) {
+    error = "the lines never swapped, the test position no longer covers it";
+    return false;
+  }
+
+  for (int multipv = 2; multipv <= num_lines; multipv++) {
+    if (window_misses[multipv] > 1) {
+      error = "line " + std::to_string(multipv) + " missed its aspiration window " +
+              std::to_string(window_misses[multipv]) + " times";
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks that a job run on more threads than the pool has (as perft and the test commands do) leaves the
+ * helpers of the pool running, so they keep their thread local data and NUMA binding, and that the number of
+ * threads is clamped to ThreadPool::MAX_THREADS.
+ *
+ * @param error; Set to the reason of a failure.
+ * @return true if the test passed.
+ */
+static bool testThreadPoolResize(std::string &error) {
+  const int pool_size = 3;
+  int original_size = threads.size();
+  threads.resize(pool_size);
+
+  std::vector<std::thread::id> ids_before(pool_size), ids_after(pool_size);
+  threads.run([&](int thread_id) { ids_before[thread_id] = std::this_thread::get_id(); });
+  std::atomic<int> num_run(0);
+  threads.run([&](int) { num_run++; }, ThreadPool::MAX_THREADS + 10);
+  int size_after = threads.size();
+  threads.run([&](int thread_id) { ids_after[thread_id] = std::this_thread::get_id(); });
+
+  threads.resize(original_size);
+  if (num_run != ThreadPool::MAX_THREADS) {
+    error = "job ran on " + std::to_string(num_run) + " threads, expected " + std::to_string(ThreadPool::MAX_THREADS);
+    return false;
+  }
+  if (size_after != pool_size) {
+    error = "pool has " + std::to_string(size_after) + " threads after the job, expected " + std::to_string(pool_size);
+    return false;
+  }
+  if (ids_before != ids_after) {
+    error = "the helpers of the pool were restarted";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Runs the built-in tests, which need no external files or engines, and prints one line per test followed
+ * by a summary.
+ *
+ * @return true if all tests passed.
+ */
+bool ChessGame::runSelfTests() {
+  const std::pair<const char *, bool (*)(std::string &)> tests[] = {
+      {"perft split", testPerftSplit},
+      {"MultiPV line swap", testMultiPVSwap},
+      {"thread pool resize", testThreadPoolResize},
+  };
+
+  int passed = 0, failed = 0;
+  for (const auto &test : tests) {
+    std::string error;
+    if (test.second(error)) {
+      std::cout << "PASS " << test.first << "\n";
+      passed++;
+    } else {
+      std::cout << "FAIL " << test.first << ": " << error << "\n";
+      failed++;
+    }
+  }
+
+  std::cout << "\nSelf tests " << (failed ? "FAILED" : "PASSED") << ": " << passed << " passed, " << failed
+            << " failed\n"
+            << std::endl;
+  return failed == 0;
+}
@@ -13,7 +13,7 @@
  * @param occupancy; Representing the occupancy of pieces on the board,
  *                   (0 for white, 1 for black, and 2 for both).
  */
-void Moves::generateMovesPawns(ChessBoard board, int color, U64 occupancy[3]) {
+void Moves::generateMovesPawns(ChessBoard& board, int color, U64 occupancy[3]) {
   // Init source, target, piece and direction
   int from_square, to_square, piece, direction;
 
@@ -110,7 +110,7 @@ void Moves::generateMovesPawns(ChessBoard board, int color, U64 occupancy[3]) {
  * @param occupancy; Representing the occupancy of pieces on the board,
  *                   (0 for white, 1 for black, and 2 for both).
  */
-void Moves::generateMovesKings(ChessBoard board, int color, U64 occupancy[3]) {
+void Moves::generateMovesKings(ChessBoard& board, int color, U64 occupancy[3]) {
   // Init source,target and piece
   int from_square, to_square, piece;
 
@@ -192,7 +192,7 @@ void Moves::generateMovesKings(ChessBoard board, int color, U64 occupancy[3]) {
  * @param piece; The specific piece type to generate moves for, identified by its unique code
  *        (e.g., WN for White Knight, BR for Black Rook).
  */
-void Moves::generateMovesPiece(ChessBoard board, U64 occupancy[3], unsigned int piece) {
+void Moves::generateMovesPiece(ChessBoard& board, U64 occupancy[3], unsigned int piece) {
   // Init source, target
   int from_square, to_square;
 
@@ -257,7 +257,7 @@ void Moves::generateMovesPiece(ChessBoard board, U64 occupancy[3], unsigned int
  *
  * @param board The current state of the chessboard, containing bitboards and all flags.
  */
-void Moves::generate_moves(ChessBoard board) {
+void Moves::generate_moves(ChessBoard& board) {
   // Init move count
   moves_count = 0;
   U64 occupancy[3];
@@ -285,6 +285,35 @@ void Moves::generate_moves(ChessBoard board) {
   }
 }
 
+/**
+ * Checks if a pseudo-legal move leaves the own king in check, without making it. The king's square is
+ * tested against the enemy pieces with the occupancy after the move, so pins and x-rays through the
+ * square the piece leaves are seen. A captured piece (also en passant) can't attack anymore.
+ * Castling moves are generated only if the king doesn't start on or cross an attacked square, so only its
+ * target square is left to check.
+ *
+ * @param board The current state of the chessboard.
+ * @param move Pseudo-legal move of the side to move.
+ * @return true if the move is legal.
+ */
+bool Moves::isLegal(ChessBoard& board, int move) {
+  int from_square = get_move_source(move);
+  int to_square = get_move_target(move);
+  int piece = get_move_piece(move);
+  int color = board.color;
+
+  U64 occupied = (board.occupancy[both] ^ (1ULL << from_square)) | (1ULL << to_square);
+  U64 captured = 1ULL << to_square;
+  if (get_move_enpassant(move)) {
+    int captured_square = (color == white) ? to_square + 8 : to_square - 8;
+    occupied ^= 1ULL << captured_square;
+    captured |= 1ULL << captured_square;
+  }
+
+  int king_square = (piece == WK || piece == BK) ? to_square : bitScanForward(board.bitboards[color == white ? WK : BK]);
+  return !(board.attackersTo(king_square, occupied) & board.occupancy[color ^ 1] & ~captured);
+}
+
 // ================================
 //   Debugging and Utility Methods
 // ================================
@@ -53,10 +53,11 @@ class Moves {
   }
 
   // --- Move Generation Methods ---
-  void generateMovesPawns(ChessBoard board, int color, U64 occupancy[3]);
-  void generateMovesKings(ChessBoard board, int color, U64 occupancy[3]);
-  void generateMovesPiece(ChessBoard board, U64 occupancy[3], unsigned int piece);
-  void generate_moves(ChessBoard board);
+  void generateMovesPawns(ChessBoard& board, int color, U64 occupancy[3]);
+  void generateMovesKings(ChessBoard& board, int color, U64 occupancy[3]);
+  void generateMovesPiece(ChessBoard& board, U64 occupancy[3], unsigned int piece);
+  void generate_moves(ChessBoard& board);
+  static bool isLegal(ChessBoard& board, int move);
 
   // --- Utility Methods ---
   void add_move(int move);
@@ -393,4 +393,46 @@ void initLeapersAttacks() {
     // Init king attacks
     king_attacks[square] = generateKingAttacks(square);
   }
-}
\ No newline at end of file
+}
+
+// =====================================
+//          ZOBRIST HASHING
+// =====================================
+
+U64 piece_keys[12][64] = {};
+U64 enpassant_keys[64] = {};
+U64 castle_keys[16] = {};
+U64 side_key = 0ULL;
+
+// Pseudo random number state, fixed seed so the keys are the same on every run
+static U64 random_state = 1804289383ULL;
+
+// Generates a pseudo random 64-bit number (xorshift64*).
+U64 getRandomU64() {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return random_state * 2685821657736338717ULL;
+}
+
+/**
+ * Initializes the random keys used for Zobrist hashing of positions. The hash key of a position is
+ * the XOR of the keys of all its pieces, the enpassant square, the castling rights and the side to move,
+ * so it can be updated incrementally when a move is made.
+ */
+void initZobristKeys() {
+  random_state = 1804289383ULL;
+
+  for (int piece = WP; piece <= BK; piece++) {
+    for (int square = 0; square < 64; square++) {
+      piece_keys[piece][square] = getRandomU64();
+    }
+  }
+  for (int square = 0; square < 64; square++) {
+    enpassant_keys[square] = getRandomU64();
+  }
+  for (int castling = 0; castling < 16; castling++) {
+    castle_keys[castling] = getRandomU64();
+  }
+  side_key = getRandomU64();
+}
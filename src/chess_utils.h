@@ -71,6 +71,10 @@ const U64 NOT_FILE_H = 9187201950435737471ULL;
 const U64 NOT_FILE_HG = 4557430888798830399ULL;
 const U64 NOT_FILE_AB = 18229723555195321596ULL;
 
+// Rank masks of the squares pawns promote from (7th rank for white, 2nd rank for black).
+const U64 RANK_7 = 0x000000000000FF00ULL;
+const U64 RANK_2 = 0x00FF000000000000ULL;
+
 // Enumeration for directional rays used in move generation for sliding pieces.
 // Rays
 enum { UP, DOWN, LEFT, RIGHT, UPLEFT, UPRIGHT, DOWNLEFT, DOWNRIGHT };
@@ -95,6 +99,17 @@ U64 getBishopMoves(unsigned int square, U64 blockers);
 U64 getRooksMoves(unsigned int square, U64 blockers);
 U64 getQueensMoves(unsigned int square, U64 blockers);
 
+// --- Zobrist Hashing ---
+
+// Random keys for hashing positions: piece on square, enpassant square, castling rights and side to move.
+extern U64 piece_keys[12][64];
+extern U64 enpassant_keys[64];
+extern U64 castle_keys[16];
+extern U64 side_key;
+
+U64 getRandomU64();
+void initZobristKeys();
+
 // Promotion piece options for white and black.
 const int WHITE_PROMOTIONS[4] = {WQ, WR, WB, WN};
 const int BLACK_PROMOTIONS[4] = {BQ, BR, BB, BN};
@@ -151,8 +166,11 @@ TriglavTactician: Strategy Peaks Here
 Available Commands:
 - uci: Start Universal Chess Interface (UCI) mode. (Also has a help command)
 - playgame: play a text based game against the engine.
-- test [path_to_stockfish_executable]: Run tests against Stockfish engine. Ensure the 'test' subfolder
+- test [path_to_stockfish_executable] [workers]: Run tests against Stockfish engine. Ensure the 'test' subfolder
 contains the 'commands.txt' file with test commands.
+- perftsuite [path_to_epd_file] [max_depth] [time_budget_s] [threads]: Check the perft counts of an EPD suite
+(e.g. test/perftsuite.epd) without an external engine.
+- selftest: Run the built-in tests, which need no external files or engines.
 - help: Display available commands and their descriptions.
 - exit: Exit the application.
 
@@ -163,8 +181,9 @@ const std::string HELP = R"(
 Available Commands:
 - uci: Start Universal Chess Interface (UCI) mode.
 - playgame: play a text based game against the engine.
-- test [path_to_stockfish_executable]: This command initiates a series of automated tests against the
-Stockfish chess engine. To use this feature, follow these guidelines:
+- test [path_to_stockfish_executable] [workers]: This command initiates a series of automated tests against the
+Stockfish chess engine. The perft commands are spread over [workers] Stockfish processes (default: all cores),
+each started once and fed through pipes. To use this feature, follow these guidelines:
 
 1. Ensure that the 'test' subfolder within your engine's directory contains a file named 'commands.txt'. This
 file should list all the chess positions and moves you want to test, formatted according to the UCI
@@ -181,6 +200,14 @@ position startpos moves d2d4
 go depth 10
 3. If you encounter issues running the tests, as a troubleshooting step, clear the 'test' subfolder of all
 files except for 'commands.txt'. This can resolve problems related to residual data from previous tests.
+- perftsuite [path_to_epd_file] [max_depth] [time_budget_s] [threads]: Checks the perft node counts listed in an
+EPD file, without an external engine. Every line holds a FEN followed by the expected counts, e.g.
+rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400 ;D3 8902
+Depths above max_depth are skipped, as are the depths not started before the time budget runs out
+(0 = no limit). The budget is only checked between depths, one long depth can overrun it. The positions are run in parallel on the given number of threads (default: all cores).
+The failed depths are listed, followed by a summary with the total nodes per second.
+- selftest: Runs the built-in tests of the engine internals (e.g. how a parallel perft is split between
+threads), which need no external files or engines. Prints PASS or FAIL per test and a summary.
 Remember to replace [path_to_stockfish_executable] with the actual file path to your Stockfish engine
 executable when using the "test" command.
 
@@ -220,8 +247,23 @@ Optionally, you can specify a sequence of moves from the current position using
     depth. Perft (Performance Test) counts all the possible legal moves up to a certain depth.
     It's a way to verify that the move generation function correctly generates all possible moves. 
     For example, 'go perft 5' will analyze all possible moves from the current position up to 5 moves
-    deep.
-
+    deep. 'go perft 7 threads 8' counts the nodes on 8 threads. 'go perft 5 verify' makes every move down
+    to the leaves instead of counting the legal moves at the last ply. 'go perft 4 stats' also counts the
+    captures, en passant captures, castles, promotions, checks and checkmates for every depth up to 4.
+
+
+5. Options:
+- Command: 'setoption name [id] value [x]'
+  - MultiPV: number of best moves searched and reported, each with its own principal variation. For example,
+    'setoption name MultiPV value 3' makes the engine report its top 3 moves as 'info multipv [1-3] ...' lines.
+  - Threads: number of search threads. For example, 'setoption name Threads value 4' searches on 4 cores.
+  - Hash: size of the transposition table in MB. For example, 'setoption name Hash value 1024'.
+  - LargePages: with 'setoption name LargePages value true' the transposition table is allocated with
+    explicit huge pages if the system has them reserved.
+  - PerftHash: size of the perft hash table in MB (0 = off). With 'setoption name PerftHash value 256'
+    'go perft' counts transposed subtrees only once.
+  - Deterministic: with 'setoption name Deterministic value true' a search with the same number of threads
+    always gives the same result, at the cost of some parallel speedup.
 
 6. Best Move:
 - When the engine has determined the best move based on its calculations, 
@@ -273,15 +315,18 @@ Setting Up:
 const std::string MESSAGE = R"(
 id name TriglavTactician
 id author Lovro
+option name MultiPV type spin default 1 min 1 max 256
+option name Threads type spin default 1 min 1 max 64
+option name Hash type spin default 64 min 1 max 65536
+option name LargePages type check default false
+option name PerftHash type spin default 0 min 0 max 65536
+option name Deterministic type check default false
 uciok
 )";
 
 
 
-const std::string OUTPUT_FILE_SF = "./test/results_sf.txt";
 const std::string OUTPUT_FILE_LB = "./test/results_lb.txt";
 const std::string COMMANDS_FILE = "./test/commands.txt";
-// Diff format, because it is run in command line
-const std::string COMMANDS_FILE_TEMP = "test/commands_temp.txt";
 
 #endif  // CHESS_UTILS_H_
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "./engine_process.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+extern char** environ;
+#endif
+
+// =================================
+//             Process
+// =================================
+
+/**
+ * Starts the engine with its stdin and stdout connected to this object. Processes must be started from one
+ * thread at a time, otherwise a child could inherit the pipes of another engine and never see its stdin close.
+ *
+ * @param path; Path to the engine executable.
+ * @return true if the process was started.
+ */
+bool EngineProcess::start(const std::string& path) {
+  stop();
+#ifdef _WIN32
+  SECURITY_ATTRIBUTES attributes = {sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+  HANDLE child_stdin, child_stdout;
+  if (!CreatePipe(&child_stdin, &to_engine, &attributes, 0)) {
+    return false;
+  }
+  if (!CreatePipe(&from_engine, &child_stdout, &attributes, 0)) {
+    CloseHandle(child_stdin);
+    CloseHandle(to_engine);
+    to_engine = nullptr;
+    return false;
+  }
+  // Only the child ends are inherited
+  SetHandleInformation(to_engine, HANDLE_FLAG_INHERIT, 0);
+  SetHandleInformation(from_engine, HANDLE_FLAG_INHERIT, 0);
+
+  STARTUPINFOA startup_info = {};
+  startup_info.cb = sizeof(startup_info);
+  startup_info.dwFlags = STARTF_USESTDHANDLES;
+  startup_info.hStdInput = child_stdin;
+  startup_info.hStdOutput = child_stdout;
+  startup_info.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+  PROCESS_INFORMATION process_info = {};
+  std::string command_line = "\"" + path + "\"";
+  bool started = CreateProcessA(nullptr, &command_line[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr,
+                                &startup_info, &process_info);
+  CloseHandle(child_stdin);
+  CloseHandle(child_stdout);
+  if (!started) {
+    CloseHandle(to_engine);
+    CloseHandle(from_engine);
+    to_engine = from_engine = nullptr;
+    return false;
+  }
+  CloseHandle(process_info.hThread);
+  process = process_info.hProcess;
+  return true;
+#else
+  int stdin_pipe[2], stdout_pipe[2];
+  if (pipe(stdin_pipe)) {
+    return false;
+  }
+  if (pipe(stdout_pipe)) {
+    close(stdin_pipe[0]);
+    close(stdin_pipe[1]);
+    return false;
+  }
+  // dup2 in the child clears the flag on stdin and stdout, all other copies are closed by exec
+  for (int fd : {stdin_pipe[0], stdin_pipe[1], stdout_pipe[0], stdout_pipe[1]}) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  // A write to an engine that exited must fail instead of killing this process
+  signal(SIGPIPE, SIG_IGN);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, stdin_pipe[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, stdout_pipe[1], STDOUT_FILENO);
+
+  // A bare file name is in the current directory, as in the shell command used before; PATH is not searched
+  std::string executable = (path.find('/') == std::string::npos) ? "./" + path : path;
+  char* argv[] = {const_cast<char*>(executable.c_str()), nullptr};
+  int error = posix_spawn(&pid, executable.c_str(), &actions, nullptr, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(stdin_pipe[0]);
+  close(stdout_pipe[1]);
+  if (error) {
+    close(stdin_pipe[1]);
+    close(stdout_pipe[0]);
+    pid = -1;
+    return false;
+  }
+  to_engine = stdin_pipe[1];
+  from_engine = stdout_pipe[0];
+  return true;
+#endif
+}
+
+/**
+ * Asks the engine to quit, closes the pipes and waits for the process to exit. Does nothing if no process
+ * is running.
+ */
+void EngineProcess::stop() {
+#ifdef _WIN32
+  if (!process) {
+    return;
+  }
+  send("quit");
+  CloseHandle(to_engine);
+  WaitForSingleObject(process, INFINITE);
+  CloseHandle(from_engine);
+  CloseHandle(process);
+  process = to_engine = from_engine = nullptr;
+#else
+  if (pid < 0) {
+    return;
+  }
+  send("quit");
+  close(to_engine);
+  waitpid(pid, nullptr, 0);
+  close(from_engine);
+  pid = -1;
+  to_engine = from_engine = -1;
+#endif
+  buffer.clear();
+}
+
+// =================================
+//          Communication
+// =================================
+
+/**
+ * Sends one command line to the engine.
+ *
+ * @param command; Command without the trailing newline.
+ * @return false if the engine is gone.
+ */
+bool EngineProcess::send(const std::string& command) {
+  std::string line = command + "\n";
+  size_t written = 0;
+  while (written < line.size()) {
+#ifdef _WIN32
+    DWORD count;
+    if (!WriteFile(to_engine, line.data() + written, DWORD(line.size() - written), &count, nullptr)) {
+      return false;
+    }
+#else
+    ssize_t count = write(to_engine, line.data() + written, line.size() - written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+#endif
+    written += size_t(count);
+  }
+  return true;
+}
+
+/**
+ * Appends the engine output available (blocks until there is some) to the buffer.
+ *
+ * @return false at the end of the output (the engine exited) or on a read error.
+ */
+bool EngineProcess::readChunk() {
+  char chunk[4096];
+#ifdef _WIN32
+  DWORD count;
+  if (!ReadFile(from_engine, chunk, sizeof(chunk), &count, nullptr) || count == 0) {
+    return false;
+  }
+#else
+  ssize_t count;
+  do {
+    count = read(from_engine, chunk, sizeof(chunk));
+  } while (count < 0 && errno == EINTR);
+  if (count <= 0) {
+    return false;
+  }
+#endif
+  buffer.append(chunk, size_t(count));
+  return true;
+}
+
+/**
+ * Reads the next line of engine output, without the line ending.
+ *
+ * @param line; Set to the line read.
+ * @return false if the engine exited before writing a whole line.
+ */
+bool EngineProcess::readLine(std::string& line) {
+  size_t end;
+  while ((end = buffer.find('\n')) == std::string::npos) {
+    if (!readChunk()) {
+      return false;
+    }
+  }
+  line = buffer.substr(0, end);
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  buffer.erase(0, end + 1);
+  return true;
+}
+
+/**
+ * Skips engine output up to and including the first line starting with token, e.g. "readyok".
+ *
+ * @param token; Start of the awaited line.
+ * @return false if the engine exited first.
+ */
+bool EngineProcess::waitFor(const std::string& token) {
+  std::string line;
+  while (readLine(line)) {
+    if (line.compare(0, token.size(), token) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
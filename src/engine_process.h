@@ -0,0 +1,46 @@
+#ifndef ENGINE_PROCESS_H_
+#define ENGINE_PROCESS_H_
+
+#include <string>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+/**
+ * External UCI engine (e.g. Stockfish) running as a child process, connected through a pipe in each
+ * direction. The process is started once and answers any number of commands, so tests against a reference
+ * engine pay the startup cost only once per process and never touch the file system.
+ */
+class EngineProcess {
+#ifdef _WIN32
+  // Windows HANDLEs, kept as void* so that windows.h is only included by engine_process.cpp
+  void* process = nullptr;
+  void* to_engine = nullptr;    // Write end of the engine's stdin
+  void* from_engine = nullptr;  // Read end of the engine's stdout
+#else
+  pid_t pid = -1;
+  int to_engine = -1;    // Write end of the engine's stdin
+  int from_engine = -1;  // Read end of the engine's stdout
+#endif
+  std::string buffer;  // Output read from the engine but not yet returned as a line
+
+  bool readChunk();
+
+ public:
+  EngineProcess() = default;
+  EngineProcess(const EngineProcess&) = delete;
+  EngineProcess& operator=(const EngineProcess&) = delete;
+  ~EngineProcess() { stop(); }
+
+  // --- Process ---
+  bool start(const std::string& path);
+  void stop();
+
+  // --- Communication ---
+  bool send(const std::string& command);
+  bool readLine(std::string& line);
+  bool waitFor(const std::string& token);
+};
+
+#endif  // ENGINE_PROCESS_H_
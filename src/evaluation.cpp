@@ -1,11 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
 #include "./evaluation.h"
+#include "./move_picker.h"
+#include "./thread_pool.h"
+#include "./transposition_table.h"
+
+// Search data of each search thread
+thread_local int ply = 0;
+thread_local U64 num_nodes = 0;
+thread_local U64 num_qnodes = 0;  // Quiescence search share of num_nodes
+thread_local int sel_depth = 0;   // Deepest ply reached in the current iteration
+thread_local int history_moves[2][64][64] = {};
+thread_local int counter_moves[12][64] = {};
+thread_local int continuation_history[2][12][64][12][64] = {};
+thread_local int pv_length[MAX_PLY] = {};
+thread_local int pv_table[MAX_PLY][MAX_PLY] = {};
 
-int ply = 0;
-U64 num_nodes = 0;
-int killer_moves[2][64] = {};
-int history_moves[12][64] = {};
-int pv_length[64] = {};
-int pv_table[64][64] = {};
+int reduction_table[64][64] = {};
 
 // print move scores DEBUG
 void print_move_scores(ChessGame& game) {
@@ -15,16 +28,16 @@ void print_move_scores(ChessGame& game) {
   for (int count = 0; count < game.moves.moves_count; count++) {
     printf("     move: ");
     game.moves.print_move(game.moves.moves[count]);
-    printf(" score: %d\n", scoreMove(game, game.moves.moves[count]));
+    printf(" score: %d\n", scoreMove(game.board, game.moves.moves[count]));
   }
 }
 
+// Written to std::cout like the rest of the search output, so it stays in order when std::cout is redirected
 void print_move(int move) {
-  if (Moves::get_move_promoted(move))
-    printf("%s%s%c", square_to_position[Moves::get_move_source(move)], square_to_position[Moves::get_move_target(move)],
-           square_to_position[Moves::get_move_promoted(move)]);
-  else
-    printf("%s%s", square_to_position[Moves::get_move_source(move)], square_to_position[Moves::get_move_target(move)]);
+  std::cout << square_to_position[Moves::get_move_source(move)] << square_to_position[Moves::get_move_target(move)];
+  if (Moves::get_move_promoted(move)) {
+    std::cout << ASCII_PIECES_LOWER[Moves::get_move_promoted(move)];
+  }
 }
 
 /**
@@ -96,102 +109,353 @@ int Evaluate(ChessBoard board) {
   return (board.color == white) ? score : -score;
 }
 
+/**
+ * Finds the piece captured by a move. En passant captures take a pawn from a square other than the
+ * move's target square.
+ *
+ * @param board; The current state of the chessboard, before the move is made.
+ * @param move; Capture move.
+ * @return The captured piece or EMPTY if there is none.
+ */
+int getCapturedPiece(ChessBoard& board, int move) {
+  int piece = Moves::get_move_piece(move);
+  if (Moves::get_move_enpassant(move)) {
+    return (piece < 6) ? BP : WP;
+  }
+
+  int to_square = Moves::get_move_target(move);
+  int range = (piece < 6) ? 6 : 0;
+  for (int victim = range; victim < range + 6; victim++) {
+    if (get_bit(board.bitboards[victim], to_square)) {
+      return victim;
+    }
+  }
+  return EMPTY;
+}
+
+/**
+ * Static Exchange Evaluation (SEE) of a move. Plays out the sequence of captures on the target square,
+ * where both sides always recapture with their least valuable attacker and may stop whenever continuing
+ * would lose material. Sliding pieces hidden behind the moved pieces (x-rays) join the exchange as the
+ * square gets uncovered.
+ *
+ * @param board; The current state of the chessboard, before the move is made.
+ * @param move; The move to be evaluated (capture or quiet move).
+ * @return Material balance of the exchange from the moving side's perspective.
+ */
+int SEE(ChessBoard& board, int move) {
+  int from_square = Moves::get_move_source(move);
+  int to_square = Moves::get_move_target(move);
+  int piece = Moves::get_move_piece(move);
+  int promoted = Moves::get_move_promoted(move);
+
+  // Material gained after each capture of the exchange
+  int gain[32];
+  int d = 0;
+
+  U64 occupied = board.occupancy[both];
+
+  // Value of the captured piece
+  gain[0] = 0;
+  if (Moves::get_move_capture(move)) {
+    int victim = getCapturedPiece(board, move);
+    if (victim != EMPTY) gain[0] = SEE_VALUE[victim];
+    if (Moves::get_move_enpassant(move)) pop_bit(occupied, (piece == WP) ? to_square + 8 : to_square - 8);
+  }
+
+  // Promoted pawn becomes the piece standing on the target square
+  if (promoted) {
+    gain[0] += SEE_VALUE[promoted] - SEE_VALUE[WP];
+    piece = promoted;
+  }
+
+  U64 diagonal_sliders = board.bitboards[WB] | board.bitboards[BB] | board.bitboards[WQ] | board.bitboards[BQ];
+  U64 straight_sliders = board.bitboards[WR] | board.bitboards[BR] | board.bitboards[WQ] | board.bitboards[BQ];
+
+  pop_bit(occupied, from_square);
+  U64 attackers = board.attackersTo(to_square, occupied) & occupied;
+  int side = (piece < 6) ? black : white;
+
+  while (d < 31) {
+    // Find the least valuable attacker of the side to recapture
+    U64 side_attackers = attackers & board.occupancy[side];
+    if (!side_attackers) break;
+
+    int attacker = -1;
+    for (int candidate = side * 6; candidate < side * 6 + 6; candidate++) {
+      if (side_attackers & board.bitboards[candidate]) {
+        attacker = candidate;
+        break;
+      }
+    }
+
+    // Speculative score if the piece standing on the square is captured
+    d++;
+    gain[d] = SEE_VALUE[piece] - gain[d - 1];
+
+    // King can't capture into a defended square
+    if ((attacker == WK || attacker == BK) && (attackers & board.occupancy[side ^ 1])) {
+      d--;
+      break;
+    }
+
+    // Remove the attacker and reveal x-ray attackers behind it
+    U64 attacker_square = side_attackers & board.bitboards[attacker];
+    occupied &= ~(attacker_square & -attacker_square);
+    attackers |= (getBishopMoves(to_square, occupied) & diagonal_sliders) |
+                 (getRooksMoves(to_square, occupied) & straight_sliders);
+    attackers &= occupied;
+
+    piece = attacker;
+    side ^= 1;
+  }
+
+  // Negamax the gains back to the first capture, each side may stop capturing when it's not profitable
+  while (d > 0) {
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    d--;
+  }
+
+  return gain[0];
+}
+
 /**
  * Scores a given move based on its type and strategic value. The function prioritizes captures
- * using the Most Valuable Victim - Least Valuable Attacker (MVV-LVA) heuristic, assigns special
- * scores to killer moves to improve move ordering in the search algorithm, and uses historical
- * move performance for non-captures.
+ * using the Most Valuable Victim - Least Valuable Attacker (MVV-LVA) heuristic and uses historical move performance for non-captures. Killer moves and losing captures are
+ * handled separately by the MovePicker stages.
  *
- * @param game; The current state of the chess game.
+ * @param board; The current state of the chessboard.
  * @param move; The move to be scored.
  * @return Integer score representing the move's strategic value.
  */
-int scoreMove(ChessGame game, int move) {
+int scoreMove(ChessBoard& board, int move) {
   // Check if the move is a capture
   if (Moves::get_move_capture(move)) {
-    // for enpassant captures
-    int target = WP;  // Default target piece is white pawn
-    int to_square = Moves::get_move_target(move);
-
-    // Determine opponent's color
-    int oppo_color = game.board.color ^ 1;
-    // Determine range of pieces based on the current player's color
-    int range = (game.board.color == 0) ? 6 : 0;
-    // Loop through opponent's pieces to find the captured piece
-    for (int piece = range; piece < (range + 6); piece++) {
-      if (get_bit(game.board.bitboards[piece], to_square)) {
-        target = piece;
-        break;
-      }
-    }
+    // Find the captured piece (pawn for enpassant captures)
+    int target = getCapturedPiece(board, move);
+    if (target == EMPTY) target = WP;
 
     // Use MVV-LVA to score captures, adding a high base value to prioritize captures
     return MVV_LVA[Moves::get_move_piece(move)][target] + 10000;
+  } else if (Moves::get_move_promoted(move)) {
+    // Quiet promotions are ordered among the captures by the value of the new piece
+    return SEE_VALUE[Moves::get_move_promoted(move)] / 10 + 10000;
   } else {
-    // For non-capture moves, check if the move is a killer move
+    // Use historical move performance for non-capture moves (killers have their own MovePicker stage)
+
     /*
-        A killer move is a non-capture move that caused a beta-cutoff
-        in a sibling node at the same depth of the search tree.
-        The rationale is that a move that is effective in one position might
-        also be effective in another similar position, even if it doesn't
-        involve capturing enemy pieces.
+    The history heuristic assigns a score to every possible move based on
+    its historical effectiveness in causing alpha-beta cutoffs. The more
+    often a move leads to cutoffs, the higher its score, and thats why we
+    considered earlyier in future searches
     */
+    int color = (Moves::get_move_piece(move) < 6) ? white : black;
+    return history_moves[color][Moves::get_move_source(move)][Moves::get_move_target(move)];
+  }
+  return 0;
+}
 
-    // Score 1st killer
-    if (killer_moves[0][ply] == move) {
-      return 9000;
-    } else if (killer_moves[1][ply] == move) {
-      // Ccore 2nd killer
-      return 8000;
-    } else {
-      // Use historical move performance for non-capture, non-killer moves
+/**
+ * Scores a quiet move for move ordering and late move reductions. The history score of the move is
+ * combined with the continuation history: how often the move caused cutoffs as a reply to the move
+ * made one ply ago and as a follow-up to our own move made two plies ago.
+ *
+ * @param ss; Search stack frame of the node the move is made from.
+ * @param move; Quiet move to be scored.
+ * @return Combined history score of the move.
+ */
+int scoreQuiet(SearchStack* ss, int move) {
+  int piece = Moves::get_move_piece(move);
+  int target = Moves::get_move_target(move);
+  int color = (piece < 6) ? white : black;
+  int score = history_moves[color][Moves::get_move_source(move)][target];
 
-      /*
-      The history heuristic assigns a score to every possible move based on
-      its historical effectiveness in causing alpha-beta cutoffs. The more
-      often a move leads to cutoffs, the higher its score, and thats why we
-      considered earlyier in future searches
-      */
-      return history_moves[Moves::get_move_piece(move)][Moves::get_move_target(move)];
+  for (int i = 0; i < 2; i++) {
+    int previous = (ss - 1 - i)->current_move;
+    if (previous) {
+      score += continuation_history[i][Moves::get_move_piece(previous)][Moves::get_move_target(previous)][piece][target];
     }
   }
-  return 0;
+  return score;
 }
 
 /**
- * Sorts the moves in a move list based on their scores to improve the efficiency of the search algorithm.
- * This sorting makes better move ordering for alpha-beta pruning by examining potentially stronger moves first.
+ * Returns the counter move of the node: the quiet move that last refuted the opponent's previous move,
+ * indexed by the piece and target square of that move.
  *
- * @param game; Rereference to the current game state, which includes the move list to be sorted.
+ * @param ss; Search stack frame of the node.
+ * @return The counter move, or 0 if there is none.
  */
-void sortMoves(ChessGame& game) {
-  // Array to hold scores for each move in the current move list
-  int move_scores[game.moves.moves_count];
+int getCounterMove(SearchStack* ss) {
+  int previous = (ss - 1)->current_move;
+  if (!previous) return 0;
+  return counter_moves[Moves::get_move_piece(previous)][Moves::get_move_target(previous)];
+}
 
-  // Assign scores to all moves in the move list
-  for (int count = 0; count < game.moves.moves_count; count++) {
-    move_scores[count] = scoreMove(game, game.moves.moves[count]);
-  }
-
-  // Perform bubble sort on the move list based on move scores
-  for (int current_move = 0; current_move < game.moves.moves_count; current_move++) {
-    for (int next_move = current_move + 1; next_move < game.moves.moves_count; next_move++) {
-      // If the next move has a higher score than the current move, swap them
-      if (move_scores[current_move] < move_scores[next_move]) {
-        // Swap scores
-        int temp_score = move_scores[current_move];
-        move_scores[current_move] = move_scores[next_move];
-        move_scores[next_move] = temp_score;
-
-        // Swap moves
-        int temp_move = game.moves.moves[current_move];
-        game.moves.moves[current_move] = game.moves.moves[next_move];
-        game.moves.moves[next_move] = temp_move;
+/**
+ * Applies a bonus (or a malus, if negative) to a history entry. The update is scaled down as the
+ * entry approaches HISTORY_MAX (history gravity), so entries never saturate and keep adapting.
+ *
+ * @param entry; History table entry to be updated.
+ * @param bonus; Bonus to be added, within [-HISTORY_MAX_BONUS, HISTORY_MAX_BONUS].
+ */
+void updateHistory(int& entry, int bonus) {
+  entry += bonus - entry * abs(bonus) / HISTORY_MAX;
+}
+
+/**
+ * Updates the quiet move ordering heuristics after a quiet move caused a beta cutoff:
+ * killer moves of the ply, counter move of the previous move, history and continuation history.
+ * The cutoff move gets a bonus, the quiet moves searched before it, which failed to cut off, get a malus.
+ *
+ * @param ss; Search stack frame of the node.
+ * @param move; Quiet move that caused the cutoff.
+ * @param depth; Remaining depth of the node.
+ * @param quiets_tried; Quiet moves searched before the cutoff move.
+ * @param quiets_count; Number of moves in quiets_tried.
+ */
+void updateQuietStats(SearchStack* ss, int move, int depth, int* quiets_tried, int quiets_count) {
+  /*
+      A killer move is a non-capture move that caused a beta-cutoff
+      in a sibling node at the same depth of the search tree.
+  */
+  if (ss->killers[0] != move) {
+    ss->killers[1] = ss->killers[0];
+    ss->killers[0] = move;
+  }
+
+  // Counter move heuristic: the refutation of a move is often the same, whatever the position
+  int previous = (ss - 1)->current_move;
+  if (previous) {
+    counter_moves[Moves::get_move_piece(previous)][Moves::get_move_target(previous)] = move;
+  }
+
+  // Deeper cutoffs are more reliable, they get a quadratically larger bonus
+  int bonus = std::min(depth * depth, HISTORY_MAX_BONUS);
+
+  for (int i = -1; i < quiets_count; i++) {
+    int quiet = (i < 0) ? move : quiets_tried[i];
+    int quiet_bonus = (i < 0) ? bonus : -bonus;
+
+    int piece = Moves::get_move_piece(quiet);
+    int target = Moves::get_move_target(quiet);
+    int color = (piece < 6) ? white : black;
+
+    // History heuristic: moves that often cause cutoffs, independent of the position
+    updateHistory(history_moves[color][Moves::get_move_source(quiet)][target], quiet_bonus);
+
+    // Continuation history: moves that work well as a reply to (or follow-up of) a given move
+    for (int j = 0; j < 2; j++) {
+      previous = (ss - 1 - j)->current_move;
+      if (previous) {
+        updateHistory(
+            continuation_history[j][Moves::get_move_piece(previous)][Moves::get_move_target(previous)][piece][target],
+            quiet_bonus);
       }
     }
   }
 }
 
+/**
+ * Ages the history tables between searches by halving every entry. What was learned in the previous
+ * search is still a good hint for the next one, but it shouldn't outweigh what the new search learns.
+ */
+void ageHistory() {
+  for (auto& color : history_moves) {
+    for (auto& source : color) {
+      for (int& entry : source) entry /= 2;
+    }
+  }
+
+  int* continuation = &continuation_history[0][0][0][0][0];
+  for (size_t i = 0; i < sizeof(continuation_history) / sizeof(int); i++) {
+    continuation[i] /= 2;
+  }
+}
+
+/**
+ * Clears all move ordering heuristics, used when a new game starts.
+ */
+void clearHistory() {
+  memset(history_moves, 0, sizeof(history_moves));
+  memset(counter_moves, 0, sizeof(counter_moves));
+  memset(continuation_history, 0, sizeof(continuation_history));
+}
+
+/**
+ * Pre-computes the late move reductions table. Reductions grow logarithmically with both the
+ * remaining depth and the number of moves already searched, so late quiet moves in deep
+ * subtrees are reduced the most.
+ */
+void initReductions() {
+  for (int depth = 1; depth < 64; depth++) {
+    for (int move_number = 1; move_number < 64; move_number++) {
+      reduction_table[depth][move_number] = int(LMR_BASE + log(depth) * log(move_number) / LMR_DIVISOR);
+    }
+  }
+}
+
+/**
+ * Returns how many plies a late quiet move should be reduced by. The base value comes from the
+ * reduction table and is then adjusted: moves with a good history score, moves searched in PV nodes,
+ * moves made while in check and moves giving check are reduced less, moves in positions whose
+ * static evaluation got worse over the last two plies are reduced more.
+ *
+ * @param depth; Remaining depth of the current node.
+ * @param move_number; Number of legal moves searched so far, including the current one.
+ * @param pv_node; True if the node has an open (alpha, beta) window.
+ * @param in_check; True if the side to move was in check before making the move.
+ * @param gives_check; True if the move gives check to the opponent.
+ * @param history_score; History heuristic score of the move.
+ * @param improving; True if the static evaluation is better than two plies ago.
+ * @return Number of plies to reduce, never so many that the search drops straight into quiescence.
+ */
+int getReduction(int depth, int move_number, bool pv_node, bool in_check, bool gives_check, int history_score,
+                 bool improving) {
+  int reduction = reduction_table[std::min(depth, 63)][std::min(move_number, 63)];
+
+  // Moves that often caused cutoffs before deserve a deeper look
+  reduction -= history_score / LMR_HISTORY_DIVISOR;
+
+  // Be more careful in PV nodes and in tactical situations
+  if (pv_node) reduction--;
+  if (in_check) reduction--;
+  if (gives_check) reduction--;
+
+  // Position is getting worse, cutoffs are less likely
+  if (!improving) reduction++;
+
+  // Keep at least one ply of regular search below the reduced move
+  return std::max(0, std::min(reduction, depth - 2));
+}
+
+/**
+ * Converts a score to be stored in the transposition table. Mate scores are measured from the root,
+ * but a position can be reached at different plies, so they are stored relative to the position.
+ *
+ * @param score; Score relative to the root.
+ * @param ply; Distance of the position from the root.
+ * @return Score relative to the position.
+ */
+int scoreToTT(int score, int ply) {
+  if (score > MATE_SCORE) return score + ply;
+  if (score < -MATE_SCORE) return score - ply;
+  return score;
+}
+
+/**
+ * Converts a score read from the transposition table back to a score relative to the root.
+ *
+ * @param score; Score relative to the position.
+ * @param ply; Distance of the position from the root.
+ * @return Score relative to the root.
+ */
+int scoreFromTT(int score, int ply) {
+  if (score > MATE_SCORE) return score - ply;
+  if (score < -MATE_SCORE) return score + ply;
+  return score;
+}
+
 /**
  * Performs a Quiescence Search on the current game position. It is a technique used to
  * avoid the horizon effect by only evaluating 'quiet' positions, or positions where
@@ -201,13 +465,25 @@ void sortMoves(ChessGame& game) {
  * The horizon effect can lead to situations where a chess engine makes a move that
  * looks good in the short term but leads to disadvantages later on.
  *
- * @param game; The current state of the chess game.
+ * Captures that can't raise the score to alpha even with a safety margin are skipped (delta pruning),
+ * and the whole node is cut when not even winning a queen would be enough.
+ *
+ * @param game; The current state of the chess game, restored before returning.
+ * @param ss; Search stack frame of the current ply.
  * @param alpha; The lower bound of the search window.
  * @param beta; The upper bound of the search window.
  * @return Evaluation score of the position.
  */
-int quSearch(ChessGame game, int alpha, int beta) {
+int quSearch(ChessGame& game, SearchStack* ss, int alpha, int beta) {
   num_nodes++;
+  num_qnodes++;
+  sel_depth = std::max(sel_depth, ply);
+
+  // Search stack is full, no deeper plies can be searched
+  if (ply >= MAX_PLY - 1) {
+    return Evaluate(game.board);
+  }
+
   // Evaluate the value of the current board position.
   int eval = Evaluate(game.board);
 
@@ -217,47 +493,62 @@ int quSearch(ChessGame game, int alpha, int beta) {
     return beta;
   }
 
+  // Big delta pruning: not even winning a queen (and promoting a pawn) can raise the score to alpha.
+  int big_delta = SEE_VALUE[WQ] + DELTA_MARGIN;
+  if (game.board.bitboards[game.board.color == white ? WP : BP] & (game.board.color == white ? RANK_7 : RANK_2)) {
+    big_delta += SEE_VALUE[WQ] - SEE_VALUE[WP];
+  }
+  if (eval + big_delta <= alpha) {
+    return alpha;
+  }
+
   // If the evaluation is greater than alpha, we have found a better move.
   if (eval > alpha) {
     // Update alpha to the new evaluation score.
     alpha = eval;
   }
 
-  game.moves.generate_moves(game.board);
-  // Sort moves to prioritize captures, which are more relevant in quiescence search.
-  sortMoves(game);
+  // Focus on capture moves only, the move picker returns them in MVV-LVA order and skips the ones losing material.
+  MovePicker picker(game.board, ss->moves);
+  int move;
 
-  for (int i = 0; i < game.moves.moves_count; i++) {
+  while ((move = picker.nextMove())) {
     if (game.timer.IsTimeOut()) {
       break;
     }
-    // Focus on capture moves only
-    if (game.moves.get_move_capture(game.moves.moves[i])) {
-      game.board.copyBoard();
-      ply++;
+    int promoted = Moves::get_move_promoted(move);
 
-      // Attempt to make the move, skip if it's illegal.
-      if (!game.MakeMove(game.moves.moves[i])) {
-        ply--;  // Revert ply if the move is not made.
-        // boardRevert() is already done in makeMove()
-        continue;
-      }
+    // Delta pruning: the captured piece (plus the promotion) isn't worth enough to reach alpha.
+    int victim = getCapturedPiece(game.board, move);
+    int delta = (victim != EMPTY ? SEE_VALUE[victim] : 0) + (promoted ? SEE_VALUE[promoted] - SEE_VALUE[WP] : 0);
+    if (eval + delta + DELTA_MARGIN <= alpha) {
+      continue;
+    }
 
-      // Recursively call quiescence search with negated and flipped alpha-beta bounds.
-      int score = -quSearch(game, -beta, -alpha);
+    game.board.saveState(ss->board_state);
+    ply++;
 
-      game.board.revertBoard();
-      ply--;
+    // Attempt to make the move, skip if it's illegal.
+    if (!game.MakeMove(move)) {
+      ply--;  // Revert ply if the move is not made.
+      // boardRevert() is already done in makeMove()
+      continue;
+    }
 
-      // Fail-hard beta cutoff check after making the capture move.
-      if (score >= beta) {
-        return beta;
-      }
+    // Recursively call quiescence search with negated and flipped alpha-beta bounds.
+    int score = -quSearch(game, ss + 1, -beta, -alpha);
 
-      // If the score from the capture move is better than alpha, update alpha.
-      if (score > alpha) {
-        alpha = score;
-      }
+    game.board.restoreState(ss->board_state);
+    ply--;
+
+    // Fail-hard beta cutoff check after making the capture move.
+    if (score >= beta) {
+      return beta;
+    }
+
+    // If the score from the capture move is better than alpha, update alpha.
+    if (score > alpha) {
+      alpha = score;
     }
   }
   // Return the best score found.
@@ -269,24 +560,62 @@ int quSearch(ChessGame game, int alpha, int beta) {
  * from the perspective of the current player. Negamax is a variant of the minimax
  * algorithm that relies on the zero-sum property of chess to simplify the implementation.
  * The function also incorporates alpha-beta pruning to improve search efficiency and
- * quiescence search to avoid the horizon effect.
+ * quiescence search to avoid the horizon effect. Moves after the first are searched with a
+ * null window (PVS), late quiet moves also with reduced depth (LMR), and re-searched only
+ * if they unexpectedly beat alpha. Nodes searched with an open window are PV nodes, all
+ * others are non-PV nodes. Results are stored in the transposition table, which provides the
+ * first move to search and score cutoffs in non-PV nodes. Shallow non-PV nodes are pruned
+ * based on the static evaluation (reverse futility pruning, razoring and futility pruning)
+ * and on the static exchange evaluation of quiet moves. PV and cut nodes without a TT move are
+ * searched one ply shallower (internal iterative reductions), their move ordering is only a guess.
+ * A TT move that is much better than all the alternatives is searched one ply deeper (singular extension).
+ *
+ * The game state is shared by the whole search: every move is undone with the board state saved in
+ * the node's search stack frame, and the children get the next frame.
  *
- * @param game; Current game state including the board, move list, and other relevant information.
+ * @param game; Current game state including the board and other relevant information, restored before returning.
+ * @param ss; Search stack frame of the current ply.
  * @param alpha; The lower bound of the search window.
  * @param beta; The upper bound of the search window.
  * @param depth; The depth to which the search should go.
+ * @param cut_node; True if the node is expected to fail high (non-PV node searched after the parent's
+ *                  first move, or child of an expected fail-low node).
  * @return Score of the board from the current player's perspective.
  */
-int NegaMax(ChessGame game, int alpha, int beta, int depth) {
+int NegaMax(ChessGame& game, SearchStack* ss, int alpha, int beta, int depth, bool cut_node) {
   // Initialize the Principal Variation length for the current ply.
   pv_length[ply] = ply;
 
   // Base case: if search has reached desired depth, evaluate the position
   // using quiescence search to avoid overlooking tactics at the horizon.
   if (depth == 0) {
-    return quSearch(game, alpha, beta);
+    return quSearch(game, ss, alpha, beta);
+  }
+
+  sel_depth = std::max(sel_depth, ply);
+
+  // Search stack is full, no deeper plies can be searched
+  if (ply >= MAX_PLY - 1) {
+    return Evaluate(game.board);
+  }
+
+  // Mate distance pruning: even mating right now can't beat a shorter mate found elsewhere,
+  // and getting mated right now can't be worse than a shorter mate against us.
+  if (ply > 0) {
+    alpha = std::max(alpha, -MATE_VALUE + ply);
+    beta = std::min(beta, MATE_VALUE - ply - 1);
+    if (alpha >= beta) {
+      return alpha;
+    }
   }
 
+  // Clear the killers of the grandchildren, so that only cousins share them
+  (ss + 2)->killers[0] = (ss + 2)->killers[1] = 0;
+
+  // Node with an open window lies on the principal variation (PV node),
+  // null window nodes only have to prove a fail high or fail low (non-PV node).
+  bool pv_node = beta - alpha > 1;
+
   int in_check = game.board.isThereCheck(game.board.color);
 
   // increase search depth if king in check to ensure
@@ -295,23 +624,125 @@ int NegaMax(ChessGame game, int alpha, int beta, int depth) {
     depth++;
   }
 
+  // Transposition table lookup: take the stored best move for move ordering and, in non-PV nodes,
+  // reuse the stored score if it was searched deep enough and its bound fits the window.
+  // Skipped in the singular extension search, which searches the node without its TT move.
+  int tt_move = 0;
+  TTEntry tt_entry;
+  if (!ss->excluded_move && tt.probe(game.board.hash_key, tt_entry)) {
+    tt_move = tt_entry.move;
+
+    if (!pv_node && ply > 0 && tt_entry.depth >= depth) {
+      int tt_score = scoreFromTT(tt_entry.score, ply);
+      if (tt_entry.flag == TT_EXACT) {
+        return std::max(alpha, std::min(tt_score, beta));
+      } else if (tt_entry.flag == TT_LOWER && tt_score >= beta) {
+        return beta;
+      } else if (tt_entry.flag == TT_UPPER && tt_score <= alpha) {
+        return alpha;
+      }
+    }
+  }
+
+  // Static evaluation of the node, kept in the search stack to tell whether the side to move is improving
+  ss->static_eval = in_check ? NO_EVAL : Evaluate(game.board);
+  bool improving = !in_check && (ss - 2)->static_eval != NO_EVAL && ss->static_eval > (ss - 2)->static_eval;
+
+  // Static evaluation based pruning at shallow non-PV nodes. Never prune when in check
+  // (the position is not quiet), when the bounds are mate scores (the margins are meaningless)
+  // or in the singular extension search, whose result must come from searching the other moves.
+  bool futility_pruning = false;
+  int static_eval = ss->static_eval;
+  if (!pv_node && !in_check && !ss->excluded_move && abs(beta) < MATE_SCORE) {
+
+    // Reverse futility pruning (static null move): the position is so good that
+    // even after losing the margin the opponent won't allow it.
+    if (depth <= RFP_MAX_DEPTH && static_eval - RFP_MARGIN[depth] >= beta) {
+      return beta;
+    }
+
+    // Razoring: the position is hopelessly below alpha, verify it with quiescence search only.
+    if (depth <= RAZOR_MAX_DEPTH && static_eval + RAZOR_MARGIN[depth] < alpha) {
+      int score = quSearch(game, ss, alpha, beta);
+      if (score <= alpha) {
+        return alpha;
+      }
+    }
+
+    // Futility pruning: quiet moves near the horizon can't bring the score back up to alpha.
+    futility_pruning = depth <= FUTILITY_MAX_DEPTH && static_eval + FUTILITY_MARGIN[depth] <= alpha;
+  }
+
+  // Internal iterative reductions: without a TT move the ordering of this node is a guess, so spend
+  // less effort on it now; the next iteration finds the TT move stored by this shallower search.
+  if (!tt_move && !ss->excluded_move && depth >= IIR_MIN_DEPTH && (pv_node || cut_node)) {
+    if (USE_IID) {
+      // Internal iterative deepening: a shallower search of the same node stores a TT move to start with
+      NegaMax(game, ss, alpha, beta, depth - IID_REDUCTION, cut_node);
+      if (tt.probe(game.board.hash_key, tt_entry)) {
+        tt_move = tt_entry.move;
+      }
+    } else {
+      depth--;
+    }
+  }
+
+  // Singular extensions: the TT move failed high before. If all other moves fail low against a
+  // beta somewhat below its score, the TT move is the only good move (singular) and deserves
+  // a deeper search. The search of the other moves runs before the MovePicker uses the frame.
+  int singular_extension = 0;
+  if (tt_move && ply > 0 && ply < MAX_PLY / 2 && depth >= SE_MIN_DEPTH && tt_entry.flag == TT_LOWER &&
+      tt_entry.depth >= depth - SE_TT_DEPTH_MARGIN && abs(tt_entry.score) < MATE_SCORE) {
+    int singular_beta = scoreFromTT(tt_entry.score, ply) - SE_MARGIN * depth;
+
+    ss->excluded_move = tt_move;
+    int score = NegaMax(game, ss, singular_beta - 1, singular_beta, (depth - 1) / 2, cut_node);
+    ss->excluded_move = 0;
+
+    if (score < singular_beta) {
+      singular_extension = 1;
+    } else if (singular_beta >= beta) {
+      // Multi-cut: another move beats singular beta, which is above beta, and so does the TT move.
+      // With several moves failing high this node is very likely a cut node.
+      return beta;
+    }
+  }
+
   // Tracks the number of legal moves found.
   int legal_moves = 0;
+  // Best move and original alpha, for the transposition table
+  int best_move = 0;
+  int alpha_original = alpha;
+
+  // Moves are generated and ordered lazily: TT move, good captures, killers, counter move, quiet moves,
+  // bad captures.
+  MovePicker picker(game.board, ss, tt_move);
+  int move;
 
-  game.moves.generate_moves(game.board);
-  sortMoves(game);  // Sort moves to improve search efficiency.
+  // Quiet moves searched so far, they get a history malus if a later move causes a cutoff
+  int quiets_tried[HISTORY_MAX_QUIETS];
+  int quiets_count = 0;
 
   num_nodes++;
 
   // Iterate through all generated moves.
-  for (int i = 0; i < game.moves.moves_count; i++) {
-    game.board.copyBoard();
-    ply++;
+  while ((move = picker.nextMove())) {
+    if (move == ss->excluded_move) continue;
+
+    int score;
+    bool is_quiet = !Moves::get_move_capture(move) && !Moves::get_move_promoted(move);
+
+    // Quiet moves putting the piece en prise at low depth (SEE is evaluated before the move is made)
+    bool see_pruning = !pv_node && !in_check && is_quiet && legal_moves > 0 && depth <= SEE_QUIET_MAX_DEPTH &&
+                       SEE(game.board, move) < -SEE_QUIET_MARGIN * depth;
+
     if (game.timer.IsTimeOut()) {
       break;
     }
+    game.board.saveState(ss->board_state);
+    ply++;
     // Attempt to make the move, skip if it's illegal.
-    if (!game.MakeMove(game.moves.moves[i])) {
+    if (!game.MakeMove(move)) {
       ply--;  // Revert ply if the move is not made.
       // boardRevert() is already done in makeMove()
       continue;
@@ -320,33 +751,54 @@ int NegaMax(ChessGame game, int alpha, int beta, int depth) {
     // increment legal moves
     legal_moves++;
 
-    // Recurse with the negated alpha and beta values, decreasing depth.
-    int score = -NegaMax(game, -beta, -alpha, depth - 1);
+    bool gives_check = is_quiet && game.board.isThereCheck(game.board.color);
 
-    game.board.revertBoard();
-    ply--;
+    // Skip futile and losing quiet moves, but always search at least one move
+    if ((futility_pruning || see_pruning) && legal_moves > 1 && is_quiet && !gives_check) {
+      game.board.restoreState(ss->board_state);
+      ply--;
+      continue;
+    }
 
-    // Fail-hard beta cutoff: stop searching if we find a move that's too good.
-    if (score >= beta) {
-      // Update killer moves if the move is a quiet move (non-capture).
-      if (!Moves::get_move_capture(game.moves.moves[i])) {
-        killer_moves[1][ply] = killer_moves[0][ply];
-        killer_moves[0][ply] = game.moves.moves[i];
+    // Late move reductions: quiet moves late in the ordering rarely cause a cutoff,
+    // so search them shallower first and only verify the ones that beat alpha.
+    int reduction = 0;
+    if (depth >= LMR_MIN_DEPTH && legal_moves > LMR_FULL_DEPTH_MOVES && is_quiet) {
+      int history_score = scoreQuiet(ss, move);
+      reduction = getReduction(depth, legal_moves, pv_node, in_check, gives_check, history_score, improving);
+    }
+    ss->current_move = move;
+    ss->reduction = reduction;
+
+    int new_depth = depth - 1 + ((move == tt_move) ? singular_extension : 0);
+
+    if (legal_moves == 1) {
+      // First move is expected to be the best one, search it with the full window.
+      score = -NegaMax(game, ss + 1, -beta, -alpha, new_depth, !pv_node && !cut_node);
+    } else {
+      // Principal variation search: prove the remaining moves are worse than alpha
+      // with a cheap null window, possibly at reduced depth.
+      score = -NegaMax(game, ss + 1, -alpha - 1, -alpha, new_depth - reduction, !cut_node);
+
+      // Reduced move beat alpha, re-search it at full depth
+      if (reduction > 0 && score > alpha) {
+        ss->reduction = 0;
+        score = -NegaMax(game, ss + 1, -alpha - 1, -alpha, new_depth, !cut_node);
       }
 
-      return beta;  // Move is too good; opponent won't allow it.
+      // Move failed high inside the window, re-search it with the full window to get the exact score
+      if (score > alpha && score < beta) {
+        score = -NegaMax(game, ss + 1, -beta, -alpha, new_depth, false);
+      }
     }
 
-    // Found a better move, update alpha.
-    if (score > alpha) {
-      // Update history table if it's a quiet move.
-      if (!Moves::get_move_capture(game.moves.moves[i])) {
-        history_moves[Moves::get_move_piece(game.moves.moves[i])][Moves::get_move_target(game.moves.moves[i])] += depth;
-      }
-      alpha = score;
+    game.board.restoreState(ss->board_state);
+    ply--;
 
-      // Update Principal Variation (PV) table.
-      pv_table[ply][ply] = game.moves.moves[i];
+    // Found a better move in a PV node, update Principal Variation (PV) table. Done before the beta cutoff:
+    // with the mate distance bound, the exact score of the shortest mate reaches beta and needs its line.
+    if (pv_node && score > alpha) {
+      pv_table[ply][ply] = move;
       for (int n_ply = ply + 1; n_ply < pv_length[ply + 1]; n_ply++) {
         // Copy move from deeper ply into current ply's line
         pv_table[ply][n_ply] = pv_table[ply + 1][n_ply];
@@ -354,42 +806,425 @@ int NegaMax(ChessGame game, int alpha, int beta, int depth) {
 
       pv_length[ply] = pv_length[ply + 1];
     }
+
+    // Fail-hard beta cutoff: stop searching if we find a move that's too good.
+    if (score >= beta) {
+      // Update killer moves, counter move and history tables if the move is a quiet move.
+      if (is_quiet) {
+        updateQuietStats(ss, move, depth, quiets_tried, quiets_count);
+      }
+
+      if (!game.timer.IsTimeOut() && !ss->excluded_move) {
+        tt.store(game.board.hash_key, move, scoreToTT(beta, ply), depth, TT_LOWER);
+      }
+      return beta;  // Move is too good; opponent won't allow it.
+    }
+
+    if (is_quiet && quiets_count < HISTORY_MAX_QUIETS) {
+      quiets_tried[quiets_count++] = move;
+    }
+
+    // Found a better move, update alpha.
+    if (score > alpha) {
+      alpha = score;
+      best_move = move;
+    }
   }
 
   // If no legal moves were found, check for checkmate or stalemate.
   if (legal_moves == 0) {
+    // Singular extension search: the excluded move is legal, the node is not a mate
+    if (ss->excluded_move) {
+      return alpha;
+    }
     if (in_check) {
       // Checkmate condition: negative score indicating loss, adjusted by ply
       // to favor delaying the loss as long as possible.
-      return -49000 + ply;
+      return -MATE_VALUE + ply;
     } else {
       // Stalemate condition: return 0 score.
       return 0;
     }
   }
 
+  // Store the result: exact score if a move raised alpha, otherwise only an upper bound.
+  // Results of the singular extension search are not stored, they don't include the TT move.
+  if (!game.timer.IsTimeOut() && !ss->excluded_move) {
+    tt.store(game.board.hash_key, best_move, scoreToTT(alpha, ply), depth,
+             (alpha > alpha_original) ? TT_EXACT : TT_UPPER);
+  }
+
   // Return the best score found for this node.
   return alpha;
 }
 
+/**
+ * Generates the legal moves of the root position. They are ordered like in the rest of the tree
+ * for the first iteration, then by the results of the previous iterations.
+ *
+ * @param game; Current state of the chess game, restored before returning.
+ * @param ss; Root frame of a cleared search stack, the MovePicker reads the empty frames before it.
+ */
+void RootMoves::generate(ChessGame& game, SearchStack* ss) {
+  MovePicker picker(game.board, ss, 0);
+  int move;
+
+  count = 0;
+  while ((move = picker.nextMove())) {
+    game.board.saveState(ss->board_state);
+    if (!game.MakeMove(move)) continue;
+    game.board.restoreState(ss->board_state);
+
+    RootMove& root_move = moves[count++];
+    root_move.move = move;
+    root_move.score = -INFINITY_SCORE;
+    root_move.previous_score = -INFINITY_SCORE;
+    root_move.nodes = 0;
+    root_move.pv_length = 1;
+    root_move.pv[0] = move;
+  }
+}
+
+/**
+ * Sorts the root moves in [begin, end) by score. Moves with the same score (e.g. all the moves that failed low)
+ * are ordered by the size of their subtrees: a move that took a lot of effort to refute is likely close to the
+ * best one. The sort is stable, so the order of the previous iteration breaks the remaining ties.
+ */
+void RootMoves::sort(int begin, int end) {
+  std::stable_sort(moves + begin, moves + end, [](const RootMove& a, const RootMove& b) {
+    return (a.score != b.score) ? a.score > b.score : a.nodes > b.nodes;
+  });
+}
+
+/**
+ * Sorts the root moves from begin on by their score in the previous iteration, before a MultiPV line is searched.
+ * The earlier lines of the iteration leave the remaining moves ordered by subtree size, so without this the line
+ * could start with any move. Now it starts with the move expected to take it, the one its aspiration window is
+ * centred on. Moves without a previous score (they failed low) keep their order.
+ *
+ * @param begin; Index of the first move of the line.
+ */
+void RootMoves::sortByPreviousScore(int begin) {
+  std::stable_sort(moves + begin, moves + count,
+                   [](const RootMove& a, const RootMove& b) { return a.previous_score > b.previous_score; });
+}
+
+/**
+ * Clears a search stack. The frames before the root stay empty so that (ss - 2) is always valid.
+ * Killer moves are cleared with it, they are only valid within one search.
+ *
+ * @param stack; Search stack of SEARCH_STACK_SIZE frames.
+ */
+void initSearchStack(SearchStack* stack) {
+  for (int i = 0; i < SEARCH_STACK_SIZE; i++) {
+    stack[i].static_eval = NO_EVAL;
+    stack[i].current_move = 0;
+    stack[i].killers[0] = stack[i].killers[1] = 0;
+    stack[i].reduction = 0;
+    stack[i].excluded_move = 0;
+  }
+}
+
+/**
+ * Searches one root move: makes it, searches the position after it (with late move reductions and a null
+ * window for all but the first move, like in NegaMax) and takes it back.
+ *
+ * @param game; Current state of the chess game, restored before returning.
+ * @param ss; Search stack frame of the root.
+ * @param move; Root move to be searched.
+ * @param moves_searched; Number of the move in the search order, counting from 1.
+ * @param alpha; The lower bound of the search window.
+ * @param beta; The upper bound of the search window.
+ * @param depth; Remaining depth at the root.
+ * @param in_check; True if the side to move at the root is in check.
+ * @return Score of the move.
+ */
+int searchRootMove(ChessGame& game, SearchStack* ss, int move, int moves_searched, int alpha, int beta, int depth,
+                   bool in_check) {
+  bool is_quiet = !Moves::get_move_capture(move) && !Moves::get_move_promoted(move);
+  int score;
+
+  game.board.saveState(ss->board_state);
+  ply++;
+  game.MakeMove(move);
+
+  bool gives_check = is_quiet && game.board.isThereCheck(game.board.color);
+
+  // Late move reductions, like in the rest of the tree
+  int reduction = 0;
+  if (depth >= LMR_MIN_DEPTH && moves_searched > LMR_FULL_DEPTH_MOVES && is_quiet) {
+    reduction = getReduction(depth, moves_searched, true, in_check, gives_check, scoreQuiet(ss, move), true);
+  }
+  ss->current_move = move;
+  ss->reduction = reduction;
+
+  if (moves_searched == 1) {
+    score = -NegaMax(game, ss + 1, -beta, -alpha, depth - 1, false);
+  } else {
+    // Principal variation search
+    score = -NegaMax(game, ss + 1, -alpha - 1, -alpha, depth - 1 - reduction, true);
+    if (reduction > 0 && score > alpha) {
+      ss->reduction = 0;
+      score = -NegaMax(game, ss + 1, -alpha - 1, -alpha, depth - 1, true);
+    }
+    if (score > alpha && score < beta) {
+      score = -NegaMax(game, ss + 1, -beta, -alpha, depth - 1, false);
+    }
+  }
+
+  game.board.restoreState(ss->board_state);
+  ply--;
+  return score;
+}
+
+/**
+ * Searches the root moves in [begin, root_moves.count) on all threads at once with a null window at alpha,
+ * to find out which of them can beat the best move so far. Every thread searches its own copy of the
+ * position with its own search stack and history tables.
+ *
+ * In deterministic mode (game.deterministic) the moves are split between the threads at fixed points
+ * (thread t searches every size-th move from begin + t) and the transposition table is read only while
+ * the threads search, so no thread can see the results of another one. The search then only depends on the
+ * number of threads, not on their timing. Otherwise idle threads take the next unsearched move and all of
+ * them share the transposition table.
+ *
+ * @param game; Current state of the chess game at the root.
+ * @param ss; Search stack frame of the root.
+ * @param root_moves; Legal root moves, node counts of the searched moves are updated.
+ * @param begin; Index of the first root move to be searched.
+ * @param alpha; Score to beat.
+ * @param depth; Remaining depth at the root.
+ * @param in_check; True if the side to move at the root is in check.
+ * @param scores; Filled with the null window score of every searched move, indexed like root_moves.
+ */
+void scoutRootMoves(ChessGame& game, SearchStack* ss, RootMoves& root_moves, int begin, int alpha, int depth,
+                    bool in_check, int* scores) {
+  int num_threads = threads.size();
+  std::atomic<int> next_move(begin);
+  U64 helper_nodes[ThreadPool::MAX_THREADS] = {};
+  U64 helper_qnodes[ThreadPool::MAX_THREADS] = {};
+  int helper_sel_depth[ThreadPool::MAX_THREADS] = {};
+
+  tt.setReadOnly(game.deterministic);
+  threads.run([&](int thread_id) {
+    static thread_local SearchStack stack[SEARCH_STACK_SIZE];
+    initSearchStack(stack);
+    SearchStack* thread_ss = stack + SEARCH_STACK_OFFSET;
+    thread_ss->static_eval = ss->static_eval;
+
+    ChessGame thread_game = game;
+    U64 nodes_start = num_nodes;
+    U64 qnodes_start = num_qnodes;
+    if (thread_id) {
+      sel_depth = 0;
+    }
+
+    int i = game.deterministic ? begin + thread_id : next_move++;
+    while (i < root_moves.count && !thread_game.timer.IsTimeOut()) {
+      U64 nodes_before = num_nodes;
+      scores[i] = searchRootMove(thread_game, thread_ss, root_moves.moves[i].move, i - begin + 2, alpha, alpha + 1,
+                                 depth, in_check);
+      root_moves.moves[i].nodes += num_nodes - nodes_before;
+      i = game.deterministic ? i + num_threads : next_move++;
+    }
+
+    helper_nodes[thread_id] = num_nodes - nodes_start;
+    helper_qnodes[thread_id] = num_qnodes - qnodes_start;
+    helper_sel_depth[thread_id] = sel_depth;
+  });
+  tt.setReadOnly(false);
+
+  // Node counts of the main thread are already in its own counters
+  for (int thread_id = 1; thread_id < num_threads; thread_id++) {
+    num_nodes += helper_nodes[thread_id];
+    num_qnodes += helper_qnodes[thread_id];
+    sel_depth = std::max(sel_depth, helper_sel_depth[thread_id]);
+  }
+}
+
+/**
+ * Searches the root position. Unlike NegaMax it doesn't generate the moves, it searches the root moves in
+ * their order from pv_index on (the moves before it are the better MultiPV lines of the iteration) and
+ * stores the score, the principal variation and the subtree node count of every move.
+ *
+ * With more than one thread (from SMP_MIN_DEPTH on) the first move is searched alone, then all threads
+ * scout the remaining moves in parallel. Only the moves that beat the first one in the scout are searched
+ * again, one by one in root order, to get their scores and principal variations.
+ *
+ * @param game; Current state of the chess game, restored before returning.
+ * @param ss; Search stack frame of the root.
+ * @param root_moves; Legal root moves.
+ * @param pv_index; Index of the first root move to be searched.
+ * @param alpha; The lower bound of the search window.
+ * @param beta; The upper bound of the search window.
+ * @param depth; The depth to which the search should go.
+ * @return Score of the best root move from pv_index on (fail-hard).
+ */
+int searchRoot(ChessGame& game, SearchStack* ss, RootMoves& root_moves, int pv_index, int alpha, int beta, int depth) {
+  num_nodes++;
+  pv_length[0] = 0;
+  (ss + 2)->killers[0] = (ss + 2)->killers[1] = 0;
+
+  bool in_check = game.board.isThereCheck(game.board.color);
+  if (in_check) {
+    depth++;
+  }
+  ss->static_eval = in_check ? NO_EVAL : Evaluate(game.board);
+
+  bool parallel = threads.size() > 1 && depth >= SMP_MIN_DEPTH;
+  int scout_scores[256];
+  int scout_alpha = alpha;
+
+  for (int i = pv_index; i < root_moves.count; i++) {
+    RootMove& root_move = root_moves.moves[i];
+    int move = root_move.move;
+    int moves_searched = i - pv_index + 1;
+
+    if (game.timer.IsTimeOut()) {
+      break;
+    }
+
+    if (parallel && moves_searched == 2) {
+      scout_alpha = alpha;
+      scoutRootMoves(game, ss, root_moves, i, alpha, depth, in_check, scout_scores);
+      if (game.timer.IsTimeOut()) {
+        break;
+      }
+    }
+
+    // Refuted by the parallel scout, alpha has only grown since
+    if (parallel && moves_searched > 1 && scout_scores[i] <= scout_alpha) {
+      root_move.score = -INFINITY_SCORE;
+      continue;
+    }
+
+    U64 nodes_before = num_nodes;
+    int score = searchRootMove(game, ss, move, moves_searched, alpha, beta, depth, in_check);
+    root_move.nodes += num_nodes - nodes_before;
+
+    // Result of an interrupted search can't be trusted
+    if (game.timer.IsTimeOut()) {
+      break;
+    }
+
+    if (score > alpha) {
+      // New best move: save its score and principal variation
+      root_move.score = score;
+      root_move.pv[0] = move;
+      root_move.pv_length = 1;
+      for (int n_ply = 1; n_ply < pv_length[1]; n_ply++) {
+        root_move.pv[root_move.pv_length++] = pv_table[1][n_ply];
+      }
+
+      pv_table[0][0] = move;
+      std::copy(root_move.pv + 1, root_move.pv + root_move.pv_length, pv_table[0] + 1);
+      pv_length[0] = root_move.pv_length;
+
+      if (score >= beta) {
+        return beta;
+      }
+      alpha = score;
+    } else {
+      // Only an upper bound is known, the move goes behind the best one
+      root_move.score = -INFINITY_SCORE;
+    }
+  }
+
+  return alpha;
+}
+
+/**
+ * Prints a UCI info line for a finished search iteration: score (in centipawns, or as "mate N" in moves
+ * if a mate was found), search depth, deepest ply reached (seldepth), total nodes visited and the principal
+ * variation. If the score is only a bound (the search failed outside the aspiration window) it is marked as
+ * "lowerbound"/"upperbound" and no PV is printed.
+ *
+ * @param root_move; Searched root move, with its principal variation.
+ * @param score; Score of the move.
+ * @param depth; Depth of the iteration.
+ * @param multipv; Rank of the line in MultiPV mode (1 = best), 0 if only one line is searched.
+ * @param bound; "lowerbound", "upperbound" or nullptr for an exact score.
+ */
+void printSearchInfo(const RootMove& root_move, int score, int depth, int multipv, const char* bound) {
+  std::cout << "info ";
+  if (multipv) {
+    std::cout << "multipv " << multipv << " ";
+  }
+
+  std::cout << "score ";
+  if (score > MATE_SCORE) {
+    // Mating in (MATE_VALUE - score) plies
+    std::cout << "mate " << (MATE_VALUE - score + 1) / 2;
+  } else if (score < -MATE_SCORE) {
+    // Getting mated in (MATE_VALUE + score) plies
+    std::cout << "mate " << -(MATE_VALUE + score) / 2;
+  } else {
+    std::cout << "cp " << score;
+  }
+  if (bound) {
+    std::cout << " " << bound << " depth " << depth << " seldepth " << sel_depth << " nodes " << num_nodes << "\n";
+    return;
+  }
+  std::cout << " depth " << depth << " seldepth " << sel_depth << " nodes " << num_nodes << " pv ";
+  // Print the Principal Variation: the sequence of best moves found during the search.
+  for (int move = 0; move < root_move.pv_length; move++) {
+    print_move(root_move.pv[move]);
+    std::cout << " ";
+  }
+  std::cout << "\n";
+}
+
 /**
  * Initiates a search on the given chess position up to a specified depth, using the Negamax algorithm.
  * It evaluates the position and decides on the best move, printing the search results.(score,depth,num_nodes,PV
  * sequence)
  *
+ * The legal root moves are generated once. After every iteration they are sorted by score and subtree size,
+ * so the next iteration starts with the best move. With a single legal move it is played right away.
+ *
+ * Iterations from ASPIRATION_MIN_DEPTH on are searched with a narrow window around the previous score.
+ * When the score falls outside the window the same depth is re-searched with the window widened in the
+ * failing direction (delta, 2*delta, 4*delta and then the full window).
+ *
+ * In MultiPV mode (game.multi_pv > 1) every iteration searches the root once per line: each search skips
+ * the root moves of the lines before it and has its own aspiration window around the line's previous score.
+ * The transposition table is shared by all lines.
+ *
  * @param game; Current state of the chess game.
  * @param depth; Depth to which the search algorithm should explore the tree.
  */
 void searchPosition(ChessGame& game, unsigned int depth) {
   num_nodes = 0;               // Reset the global nodes counter
+  num_qnodes = 0;              // Reset the quiescence search nodes counter
   ply = 0;                     // Reset the global depth counter
   ChessGame game_temp = game;  // Copy of the game state, so we don't change it
-  int score;
-  int alpha = -50000;
-  int beta = 50000;
 
-  // Perform the Negamax search
-  // Extreme alpha, beta values ensure  the search explores all possible outcomes within the specified depth.
+  // Keep what was learned in the previous search, at half the weight (every thread has its own tables)
+  threads.run([](int) { ageHistory(); });
+
+  SearchStack stack[SEARCH_STACK_SIZE];
+  initSearchStack(stack);
+  SearchStack* root = stack + SEARCH_STACK_OFFSET;
+
+  static RootMoves root_moves;
+  root_moves.generate(game_temp, root);
+
+  // No need to search forced moves (and nothing to search when mated or stalemated)
+  if (root_moves.count <= 1) {
+    std::cout << " bestmove ";
+    if (root_moves.count) {
+      print_move(root_moves.moves[0].move);
+    } else {
+      std::cout << "0000";
+    }
+    std::cout << "\n ";
+    game.best_move = root_moves.count ? root_moves.moves[0].move : 0;
+    return;
+  }
+
+  // Number of lines to search, there can't be more than legal root moves
+  int num_lines = std::max(1, std::min(game.multi_pv, root_moves.count));
+  int best_move = 0;  // Best move of the last fully searched iteration
 
   // Added iterative deepening
   for (int curr_depth = 1; curr_depth <= depth; curr_depth++) {
@@ -397,31 +1232,94 @@ void searchPosition(ChessGame& game, unsigned int depth) {
       break;
     }
 
-    score = NegaMax(game_temp, alpha, beta, curr_depth);
+    sel_depth = 0;
 
-    // we fell outside the window, so try again with a full-width window (and the same depth)
-    if ((score <= alpha) || (score >= beta)) {
-      alpha = -50000;
-      beta = 50000;
-      continue;
+    // Scores of the previous iteration set up the aspiration windows
+    for (int i = 0; i < root_moves.count; i++) {
+      root_moves.moves[i].previous_score = root_moves.moves[i].score;
     }
-    // set up the window for the next iteration
-    alpha = score - 50;
-    beta = score + 50;
 
-    // Print search information: score (in centipawns), search depth, and total nodes visited.
-    std::cout << "info score cp " << score << " depth " << curr_depth << " nodes " << num_nodes << " pv ";
-    // Print the Principal Variation: the sequence of best moves found during the search.
-    for (int move = 0; move < pv_length[0]; move++) {
-      print_move(pv_table[0][move]);
-      std::cout << " ";
+    for (int pv_index = 0; pv_index < num_lines; pv_index++) {
+      int multipv = (num_lines > 1) ? pv_index + 1 : 0;  // Lines are only numbered in MultiPV mode
+
+      // Extreme alpha, beta values ensure the search explores all possible outcomes within the specified depth.
+      int alpha = -INFINITY_SCORE;
+      int beta = INFINITY_SCORE;
+      int delta = ASPIRATION_WINDOW;
+      int widenings = 0;
+      int score;
+
+      // Set up the aspiration window around the previous score of the move the line starts with
+      if (pv_index > 0) {
+        root_moves.sortByPreviousScore(pv_index);
+      }
+      int previous_score = root_moves.moves[pv_index].previous_score;
+      if (curr_depth >= ASPIRATION_MIN_DEPTH && previous_score > -INFINITY_SCORE) {
+        alpha = std::max(previous_score - delta, -INFINITY_SCORE);
+        beta = std::min(previous_score + delta, INFINITY_SCORE);
+      }
+
+      while (true) {
+        score = searchRoot(game_temp, root, root_moves, pv_index, alpha, beta, curr_depth);
+
+        // Best moves first, also after a failed search, so the re-search starts with the move that failed high
+        root_moves.sort(pv_index, root_moves.count);
+
+        // Result of an interrupted iteration can't be trusted
+        if (game.timer.IsTimeOut()) {
+          break;
+        }
+
+        // We fell outside the window, re-search the same depth with the window widened in the failing direction
+        bool fail_low = score <= alpha && alpha > -INFINITY_SCORE;
+        bool fail_high = score >= beta && beta < INFINITY_SCORE;
+        if (!fail_low && !fail_high) {
+          break;
+        }
+
+        printSearchInfo(root_moves.moves[pv_index], score, curr_depth, multipv,
+                        fail_low ? "upperbound" : "lowerbound");
+
+        delta *= 2;
+        widenings++;
+        if (widenings >= ASPIRATION_MAX_WIDENINGS) {
+          alpha = -INFINITY_SCORE;
+          beta = INFINITY_SCORE;
+        } else if (fail_low) {
+          alpha = std::max(alpha - delta, -INFINITY_SCORE);
+        } else {
+          beta = std::min(beta + delta, INFINITY_SCORE);
+        }
+      }
+
+      if (game.timer.IsTimeOut()) {
+        break;
+      }
+    }
+
+    // Keep the PV of the last completed iteration if time ran out (unless there is none yet)
+    if (game.timer.IsTimeOut()) {
+      if (!best_move) {
+        best_move = root_moves.moves[0].move;
+      }
+      break;
+    }
+
+    // Lines searched later can still score better (their windows and TT entries differ), report them by score
+    root_moves.sort(0, num_lines);
+    best_move = root_moves.moves[0].move;
+    for (int i = 0; i < num_lines; i++) {
+      printSearchInfo(root_moves.moves[i], root_moves.moves[i].score, curr_depth, (num_lines > 1) ? i + 1 : 0,
+                      nullptr);
     }
-    std::cout << "\n";
   }
 
+  // Report how much of the search was spent in quiescence search
+  std::cout << "info string qnodes " << num_qnodes << " of " << num_nodes << " nodes\n";
+
   std::cout << " ";
   std::cout << "bestmove ";
-  print_move(pv_table[0][0]);
+  print_move(best_move);
   std::cout << "\n ";
-  game.best_move = pv_table[0][0];
+  game.best_move = best_move;
 }
@@ -5,6 +5,7 @@
 #include "./chess_game.h"
 #include "./chess_moves.h"
 #include "./chess_utils.h"
+#include "./search_stack.h"
 
 // Forward declaration
 class ChessGame;
@@ -12,6 +13,9 @@ class ChessGame;
 // Material score values for each piece type
 const int material_score[12] = {100, 300, 350, 500, 1000, 10000, -100, -300, -350, -500, -1000, -10000};
 
+// Piece values used by the static exchange evaluation
+const int SEE_VALUE[12] = {100, 300, 350, 500, 1000, 10000, 100, 300, 350, 500, 1000, 10000};
+
 // clang-format off
 // Pawn positional score
 const int PAWN_SCORE[64] = 
@@ -139,20 +143,116 @@ const int MVV_LVA[12][12] = {
 */
 // clang-format on
 
+// Score bounds of the search window
+const int INFINITY_SCORE = 50000;
+const int MATE_VALUE = 49000;  // Score of being mated at the root, mated at ply N scores -MATE_VALUE + N
+const int MATE_SCORE = 48000;  // Scores beyond this bound are mate scores
+
+// Aspiration windows tuning parameters
+const int ASPIRATION_MIN_DEPTH = 4;     // Shallower iterations are searched with the full window
+const int ASPIRATION_WINDOW = 50;       // Initial half-width of the window around the previous score
+const int ASPIRATION_MAX_WIDENINGS = 3; // Failures allowed before falling back to the full window
+
+// Late move reductions (LMR) tuning parameters
+const int LMR_MIN_DEPTH = 3;            // Minimum remaining depth at which quiet moves get reduced
+const int LMR_FULL_DEPTH_MOVES = 3;     // Number of moves searched at full depth before reducing
+const double LMR_BASE = 0.75;           // Constant part of the reduction formula
+const double LMR_DIVISOR = 2.25;        // Divisor of the log(depth) * log(move number) part
+const int LMR_HISTORY_DIVISOR = 8192;   // History score worth one ply less of reduction
+
+// Internal iterative reductions (IIR): nodes without a TT move are searched one ply shallower.
+// With USE_IID, they get an internal iterative deepening search to find a TT move instead.
+const int IIR_MIN_DEPTH = 4;   // Minimum remaining depth of PV and cut nodes to be reduced
+const bool USE_IID = false;    // Use internal iterative deepening instead of the reduction
+const int IID_REDUCTION = 2;   // Depth reduction of the internal iterative deepening search
+
+// Singular extensions: the TT move is extended if all other moves fail low against a reduced beta
+const int SE_MIN_DEPTH = 6;        // Minimum remaining depth of the node
+const int SE_TT_DEPTH_MARGIN = 3;  // TT entry may be this much shallower than the node
+const int SE_MARGIN = 2;           // Singular beta lies SE_MARGIN * depth below the TT score
+
+// Static evaluation based pruning tuning parameters (indexed by remaining depth)
+const int RFP_MAX_DEPTH = 3;                         // Reverse futility pruning (static null move)
+const int RFP_MARGIN[4] = {0, 120, 240, 360};
+const int FUTILITY_MAX_DEPTH = 3;                    // Futility pruning of quiet moves
+const int FUTILITY_MARGIN[4] = {0, 150, 300, 500};
+const int RAZOR_MAX_DEPTH = 3;                       // Razoring into quiescence search
+const int RAZOR_MARGIN[4] = {0, 300, 450, 600};
+
+// Static exchange evaluation (SEE) pruning parameters
+const int SEE_QUIET_MAX_DEPTH = 3;     // Quiet moves losing material are pruned up to this depth
+const int SEE_QUIET_MARGIN = 60;       // Material a quiet move may lose per ply of remaining depth
+
+// History heuristic parameters. Entries are updated with gravity: entry += bonus - entry * |bonus| / HISTORY_MAX,
+// so they stay within [-HISTORY_MAX, HISTORY_MAX] and recent results weigh more than old ones.
+const int HISTORY_MAX = 16384;       // Bound of a history entry
+const int HISTORY_MAX_BONUS = 1200;  // Bound of the depth * depth bonus (and malus) of a single update
+const int HISTORY_MAX_QUIETS = 64;   // Quiet moves remembered per node for the malus
+
+// Delta pruning parameters for quiescence search
+const int DELTA_MARGIN = 200;  // Safety margin added to the material a capture can win
+
+// MultiPV: number of best root moves searched and reported with their own principal variation
+const int MAX_MULTI_PV = 256;
+
+// Parallel search: from this depth on, the root moves after the first one are scouted by all threads at once
+const int SMP_MIN_DEPTH = 4;
+
+// Legal move of the root position, with its search results
+struct RootMove {
+  int move;
+  int score;           // Score of the last search of the move, -INFINITY_SCORE if it failed low
+  int previous_score;  // Score in the previous iteration
+  U64 nodes;           // Nodes searched in the subtree of the move, over all iterations
+  int pv_length;
+  int pv[MAX_PLY];     // Principal variation starting with the move
+};
+
+// Legal root moves, generated once per search and reordered after every iteration
+struct RootMoves {
+  RootMove moves[256];
+  int count;
+
+  void generate(ChessGame& game, SearchStack* ss);
+  void sort(int begin, int end);
+  void sortByPreviousScore(int begin);
+};
+
 // Declarations for additional functions and tables
-extern int killer_moves[2][64];
-extern int history_moves[12][64];
-extern int pv_length[64];
-extern int pv_table[64][64];  // PV-> principal variation sequence of moves that programs consider best 
+extern int reduction_table[64][64];  // LMR table [depth][move number]
+extern thread_local int history_moves[2][64][64];                   // [color][source][target]
+extern thread_local int counter_moves[12][64];                      // [previous piece][previous target]
+extern thread_local int continuation_history[2][12][64][12][64];  // [plies back - 1][previous piece][previous target][piece][target]
+extern thread_local int pv_length[MAX_PLY];
+extern thread_local int pv_table[MAX_PLY][MAX_PLY];  // PV-> principal variation sequence of moves that programs consider best 
 
 // Function declarations
 void print_move_scores(ChessGame& game);
 void print_move(int move);
 int Evaluate(ChessBoard board);
-int scoreMove(ChessGame game, int move);
-void sortMoves(ChessGame& game);
-int quSearch(ChessGame game, int alpha, int beta); // quiescence search
-int NegaMax(ChessGame game, int alpha, int beta, int depth);
+int getCapturedPiece(ChessBoard& board, int move);
+int SEE(ChessBoard& board, int move);
+int scoreMove(ChessBoard& board, int move);
+int scoreQuiet(SearchStack* ss, int move);
+int getCounterMove(SearchStack* ss);
+void updateHistory(int& entry, int bonus);
+void updateQuietStats(SearchStack* ss, int move, int depth, int* quiets_tried, int quiets_count);
+void ageHistory();
+void clearHistory();
+int scoreToTT(int score, int ply);
+int scoreFromTT(int score, int ply);
+int quSearch(ChessGame& game, SearchStack* ss, int alpha, int beta); // quiescence search
+void initReductions();
+int getReduction(int depth, int move_number, bool pv_node, bool in_check, bool gives_check, int history_score,
+                 bool improving);
+int NegaMax(ChessGame& game, SearchStack* ss, int alpha, int beta, int depth, bool cut_node);
+void initSearchStack(SearchStack* stack);
+int searchRootMove(ChessGame& game, SearchStack* ss, int move, int moves_searched, int alpha, int beta, int depth,
+                   bool in_check);
+void scoutRootMoves(ChessGame& game, SearchStack* ss, RootMoves& root_moves, int begin, int alpha, int depth,
+                    bool in_check, int* scores);
+int searchRoot(ChessGame& game, SearchStack* ss, RootMoves& root_moves, int pv_index, int alpha, int beta, int depth);
+void printSearchInfo(const RootMove& root_move, int score, int depth, int multipv, const char* bound);
 void searchPosition(ChessGame& game, unsigned int depth);
 
 #endif  // EVALUATION_H_
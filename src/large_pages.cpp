@@ -0,0 +1,83 @@
+#include "./large_pages.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/**
+ * Allocates uninitialized memory for a large table. With use_hugetlb an explicit huge page mapping
+ * (MAP_HUGETLB, needs huge pages reserved in /proc/sys/vm/nr_hugepages) is tried first. Otherwise, or if it
+ * fails, the memory is 2 MB aligned and marked with MADV_HUGEPAGE, so transparent huge pages can back it.
+ *
+ * @param size; Size in bytes.
+ * @param use_hugetlb; Try explicit huge pages first.
+ * @param page_mode; Set to the pages actually used: PAGES_DEFAULT, PAGES_TRANSPARENT_HUGE or PAGES_HUGETLB.
+ * @return Allocated memory, to be released with freeLarge(). Throws std::bad_alloc on failure.
+ */
+void* allocateLarge(size_t size, bool use_hugetlb, int& page_mode) {
+#ifdef __linux__
+  size_t rounded_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+  if (use_hugetlb) {
+    void* memory = mmap(nullptr, rounded_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                        -1, 0);
+    if (memory != MAP_FAILED) {
+      page_mode = PAGES_HUGETLB;
+      return memory;
+    }
+  }
+
+  void* memory = aligned_alloc(HUGE_PAGE_SIZE, rounded_size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  page_mode = madvise(memory, rounded_size, MADV_HUGEPAGE) ? PAGES_DEFAULT : PAGES_TRANSPARENT_HUGE;
+  return memory;
+#else
+  (void)use_hugetlb;
+  void* memory = malloc(size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  page_mode = PAGES_DEFAULT;
+  return memory;
+#endif
+}
+
+/**
+ * Releases memory allocated with allocateLarge().
+ *
+ * @param memory; The allocated memory (nullptr is ignored).
+ * @param size; Size in bytes, as passed to allocateLarge().
+ * @param page_mode; Page mode returned by allocateLarge().
+ */
+void freeLarge(void* memory, size_t size, int page_mode) {
+  if (!memory) {
+    return;
+  }
+#ifdef __linux__
+  if (page_mode == PAGES_HUGETLB) {
+    munmap(memory, (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    return;
+  }
+#else
+  (void)size;
+  (void)page_mode;
+#endif
+  free(memory);
+}
+
+// Name of the page mode for UCI info strings
+const char* pageModeName(int page_mode) {
+  switch (page_mode) {
+    case PAGES_HUGETLB:
+      return "huge pages (MAP_HUGETLB)";
+    case PAGES_TRANSPARENT_HUGE:
+      return "transparent huge pages";
+    default:
+      return "default pages";
+  }
+}
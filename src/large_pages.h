@@ -0,0 +1,21 @@
+#ifndef LARGE_PAGES_H_
+#define LARGE_PAGES_H_
+
+#include <cstddef>
+
+// Pages backing a large allocation
+enum { PAGES_DEFAULT, PAGES_TRANSPARENT_HUGE, PAGES_HUGETLB };
+
+// Size of a huge page on x86-64 Linux, large allocations are aligned and rounded up to it
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Allocations for large, randomly accessed tables (transposition table). Backing them with 2 MB pages
+ * instead of 4 KB ones avoids a TLB miss on nearly every probe. Only Linux gets huge pages, other platforms
+ * use plain malloc.
+ */
+void* allocateLarge(size_t size, bool use_hugetlb, int& page_mode);
+void freeLarge(void* memory, size_t size, int page_mode);
+const char* pageModeName(int page_mode);
+
+#endif  // LARGE_PAGES_H_
@@ -0,0 +1,215 @@
+#include "./move_picker.h"
+
+#include <algorithm>
+
+#include "./evaluation.h"
+
+MovePicker::MovePicker(ChessBoard& board, SearchStack* ss, int tt_move)
+    : board(board),
+      moves(ss->moves),
+      ss(ss),
+      stage(STAGE_TT_MOVE),
+      captures_only(false),
+      tt_move(tt_move),
+      killers{ss->killers[0], ss->killers[1]},
+      counter_move(getCounterMove(ss)) {
+  // Skip the TT move stage if there is no TT move, or the stored move doesn't fit the position (hash collision)
+  if (!tt_move || !isPseudoLegal(tt_move)) {
+    this->tt_move = 0;
+    stage = STAGE_GENERATE;
+  }
+}
+
+MovePicker::MovePicker(ChessBoard& board, Moves& moves)
+    : board(board),
+      moves(moves),
+      ss(nullptr),
+      stage(STAGE_GENERATE),
+      captures_only(true),
+      tt_move(0),
+      killers{0, 0},
+      counter_move(0) {}
+
+/**
+ * Checks if a move (usually from the transposition table) is a pseudo-legal move in the current position,
+ * by generating only the moves of the moving piece type.
+ *
+ * @param move; The move to be checked.
+ * @return true if the move is pseudo-legal.
+ */
+bool MovePicker::isPseudoLegal(int move) {
+  int piece = Moves::get_move_piece(move);
+  int color = (piece < 6) ? white : black;
+
+  if (color != board.color || !get_bit(board.bitboards[piece], Moves::get_move_source(move))) {
+    return false;
+  }
+
+  moves.moves_count = 0;
+  if (piece == WP || piece == BP) {
+    moves.generateMovesPawns(board, color, board.occupancy);
+  } else if (piece == WK || piece == BK) {
+    moves.generateMovesKings(board, color, board.occupancy);
+  } else {
+    moves.generateMovesPiece(board, board.occupancy, piece);
+  }
+
+  for (int i = 0; i < moves.moves_count; i++) {
+    if (moves.moves[i] == move) return true;
+  }
+  return false;
+}
+
+/**
+ * Checks if a capture loses material. SEE is only needed when the attacker is worth more than the victim,
+ * otherwise the capture can't lose material. Promotions are never considered bad.
+ *
+ * @param move; Capture move.
+ * @return true if the capture loses material.
+ */
+bool MovePicker::isBadCapture(int move) {
+  if (Moves::get_move_promoted(move)) return false;
+
+  int victim = getCapturedPiece(board, move);
+  if (victim != EMPTY && SEE_VALUE[Moves::get_move_piece(move)] <= SEE_VALUE[victim]) return false;
+
+  return SEE(board, move) < 0;
+}
+
+/**
+ * Selects the highest scored move in [begin, end) and swaps it to position begin (partial selection sort).
+ *
+ * @return The selected move.
+ */
+int MovePicker::pickBest(int begin, int end) {
+  int best = begin;
+  for (int i = begin + 1; i < end; i++) {
+    if (scores[i] > scores[best]) best = i;
+  }
+
+  std::swap(moves.moves[begin], moves.moves[best]);
+  std::swap(scores[begin], scores[best]);
+
+  return moves.moves[begin];
+}
+
+/**
+ * Returns the next move to be searched, generating and scoring the moves lazily.
+ *
+ * @return The next pseudo-legal move, or 0 when there are no moves left.
+ */
+int MovePicker::nextMove() {
+  while (true) {
+    switch (stage) {
+      case STAGE_TT_MOVE:
+        stage = STAGE_GENERATE;
+        return tt_move;
+
+      case STAGE_GENERATE: {
+        moves.generate_moves(board);
+
+        // Partition the move list into captures (and promotions) followed by quiet moves
+        end_captures = 0;
+        for (int i = 0; i < moves.moves_count; i++) {
+          int move = moves.moves[i];
+          if (Moves::get_move_capture(move) || (!captures_only && Moves::get_move_promoted(move))) {
+            std::swap(moves.moves[i], moves.moves[end_captures]);
+            scores[end_captures] = scoreMove(board, move);
+            end_captures++;
+          }
+        }
+
+        current = 0;
+        end_bad = 0;
+        stage = STAGE_GOOD_CAPTURES;
+        break;
+      }
+
+      case STAGE_GOOD_CAPTURES:
+        while (current < end_captures) {
+          int move = pickBest(current, end_captures);
+
+          // Keep losing captures for the last stage
+          if (isBadCapture(move)) {
+            std::swap(moves.moves[end_bad], moves.moves[current]);
+            std::swap(scores[end_bad], scores[current]);
+            end_bad++;
+            current++;
+            continue;
+          }
+
+          current++;
+          if (move != tt_move) return move;
+        }
+
+        if (captures_only) {
+          stage = STAGE_DONE;
+          break;
+        }
+        current = 0;
+        stage = STAGE_KILLERS;
+        break;
+
+      case STAGE_KILLERS:
+        /*
+            A killer move is a non-capture move that caused a beta-cutoff
+            in a sibling node at the same depth of the search tree.
+            The rationale is that a move that is effective in one position might
+            also be effective in another similar position, even if it doesn't
+            involve capturing enemy pieces.
+        */
+        // Killers are only returned if they are quiet moves of this position
+        while (current < 2) {
+          int killer = killers[current++];
+          if (!killer || killer == tt_move) continue;
+
+          for (int i = end_captures; i < moves.moves_count; i++) {
+            if (moves.moves[i] == killer) return killer;
+          }
+        }
+
+        stage = STAGE_COUNTER_MOVE;
+        break;
+
+      case STAGE_COUNTER_MOVE:
+        // Score the quiet moves: history and continuation history of the move
+        for (int i = end_captures; i < moves.moves_count; i++) {
+          scores[i] = scoreQuiet(ss, moves.moves[i]);
+        }
+        current = end_captures;
+        stage = STAGE_QUIETS;
+
+        // Quiet move that refuted the opponent's last move elsewhere in the tree
+        if (counter_move && counter_move != tt_move && counter_move != killers[0] && counter_move != killers[1]) {
+          for (int i = end_captures; i < moves.moves_count; i++) {
+            if (moves.moves[i] == counter_move) return counter_move;
+          }
+        }
+        break;
+
+      case STAGE_QUIETS:
+        while (current < moves.moves_count) {
+          int move = pickBest(current, moves.moves_count);
+          current++;
+          if (move != tt_move && move != killers[0] && move != killers[1] && move != counter_move) return move;
+        }
+
+        current = 0;
+        stage = STAGE_BAD_CAPTURES;
+        break;
+
+      case STAGE_BAD_CAPTURES:
+        // Already in MVV-LVA order
+        while (current < end_bad) {
+          int move = moves.moves[current++];
+          if (move != tt_move) return move;
+        }
+
+        stage = STAGE_DONE;
+        break;
+
+      case STAGE_DONE:
+        return 0;
+    }
+  }
+}
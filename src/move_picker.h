@@ -0,0 +1,58 @@
+#ifndef MOVE_PICKER_H_
+#define MOVE_PICKER_H_
+
+#include "./chess_board.h"
+#include "./chess_moves.h"
+#include "./chess_utils.h"
+#include "./search_stack.h"
+
+// Stages in which the MovePicker returns moves
+enum {
+  STAGE_TT_MOVE,
+  STAGE_GENERATE,
+  STAGE_GOOD_CAPTURES,
+  STAGE_KILLERS,
+  STAGE_COUNTER_MOVE,
+  STAGE_QUIETS,
+  STAGE_BAD_CAPTURES,
+  STAGE_DONE
+};
+
+/**
+ * Returns the pseudo-legal moves of a position one at a time, in stages:
+ * TT move (tried before any move generation), good captures, killer moves, counter move, quiet moves
+ * and bad captures.
+ * Within a stage the best remaining move is selected on demand, so the ordering cost is proportional
+ * to the number of moves actually tried, not to the size of the move list.
+ */
+class MovePicker {
+ public:
+  // Main search: all moves, ordered with the heuristics kept in the search stack
+  MovePicker(ChessBoard& board, SearchStack* ss, int tt_move);
+  // Quiescence search: good captures only
+  MovePicker(ChessBoard& board, Moves& moves);
+
+  int nextMove();
+
+ private:
+  ChessBoard& board;
+  Moves& moves;     // Move list storage, owned by the node's search stack frame
+  SearchStack* ss;  // Search stack frame of the node, nullptr in quiescence search
+  int scores[256];
+
+  int stage;
+  bool captures_only;
+  int tt_move;
+  int killers[2];
+  int counter_move;
+
+  int current;       // Next move to look at in the current stage
+  int end_captures;  // Captures and promotions are in [0, end_captures), quiet moves after them
+  int end_bad;       // Losing captures are moved to [0, end_bad) while the good captures are picked
+
+  int pickBest(int begin, int end);
+  bool isPseudoLegal(int move);
+  bool isBadCapture(int move);
+};
+
+#endif  // MOVE_PICKER_H_
@@ -0,0 +1,126 @@
+#include "./numa.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+
+#include <filesystem>
+#endif
+
+/**
+ * Parses a Linux CPU list, e.g. "0-3,8-11".
+ *
+ * @param cpu_list; CPU ranges separated by commas.
+ * @return Numbers of the listed CPUs.
+ */
+static std::vector<int> parseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  size_t position = 0;
+  while (position < cpu_list.size()) {
+    size_t end = cpu_list.find(',', position);
+    if (end == std::string::npos) end = cpu_list.size();
+
+    std::string range = cpu_list.substr(position, end - position);
+    size_t dash = range.find('-');
+    if (!range.empty() && isdigit(range[0])) {
+      int first = std::stoi(range);
+      int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    position = end + 1;
+  }
+  return cpus;
+}
+
+/**
+ * Discovers the NUMA nodes from /sys/devices/system/node once, on the first call.
+ * Nodes without CPUs (memory only) are skipped.
+ */
+const std::vector<std::vector<int>>& numaNodes() {
+  static const std::vector<std::vector<int>> nodes = [] {
+    std::vector<std::pair<int, std::vector<int>>> numbered_nodes;
+#ifdef __linux__
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+      std::string name = entry.path().filename().string();
+      if (name.compare(0, 4, "node") || name.size() == 4 || !isdigit(name[4])) continue;
+
+      std::ifstream file(entry.path() / "cpulist");
+      std::string cpu_list;
+      if (!std::getline(file, cpu_list)) continue;
+
+      std::vector<int> cpus = parseCpuList(cpu_list);
+      if (!cpus.empty()) {
+        numbered_nodes.emplace_back(std::stoi(name.substr(4)), cpus);
+      }
+    }
+#endif
+    std::sort(numbered_nodes.begin(), numbered_nodes.end());
+
+    std::vector<std::vector<int>> result;
+    for (auto& node : numbered_nodes) result.push_back(node.second);
+    return result;
+  }();
+  return nodes;
+}
+
+#ifdef __linux__
+/**
+ * CPU affinity of the process before any thread was bound, read on the first call. The main thread binds
+ * itself before starting the helpers, so the first call always comes before any binding.
+ */
+static const cpu_set_t& originalAffinity() {
+  static const cpu_set_t affinity = [] {
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set)) {
+      CPU_ZERO(&cpu_set);
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &cpu_set);
+    }
+    return cpu_set;
+  }();
+  return affinity;
+}
+#endif
+
+/**
+ * Binds the calling thread to the CPUs of one NUMA node. Threads are spread over the nodes round-robin,
+ * so consecutive threads land on different sockets. Does nothing with a single node.
+ *
+ * @param thread_id; Index of the thread in the thread pool.
+ */
+void bindThreadToNode(int thread_id) {
+  const std::vector<std::vector<int>>& nodes = numaNodes();
+  if (nodes.size() < 2) {
+    return;
+  }
+
+#ifdef __linux__
+  originalAffinity();
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : nodes[thread_id % nodes.size()]) {
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+/**
+ * Restores the original CPU affinity of the calling thread, e.g. of the main thread once the search runs
+ * on it alone. Does nothing with a single node, where no thread is ever bound.
+ */
+void unbindThread() {
+  if (numaNodes().size() < 2) {
+    return;
+  }
+
+#ifdef __linux__
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &originalAffinity());
+#endif
+}
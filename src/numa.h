@@ -0,0 +1,21 @@
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include <vector>
+
+/**
+ * NUMA support (Linux only). On machines with more than one NUMA node, search threads are bound
+ * to the nodes round-robin, so each thread allocates and touches its memory on its own node.
+ * On other platforms and single node machines nothing is bound.
+ */
+
+// CPUs of every NUMA node with CPUs, ordered by node number. Empty if the topology is not available.
+const std::vector<std::vector<int>>& numaNodes();
+
+// Binds the calling thread to the CPUs of NUMA node (thread_id % number of nodes)
+void bindThreadToNode(int thread_id);
+
+// Gives the calling thread back the CPUs the process was started with
+void unbindThread();
+
+#endif  // NUMA_H_
@@ -1,5 +1,13 @@
 #include "./perft.h"
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <new>
+
+#include "./thread_pool.h"
+
 // Returns the current time in milliseconds
 long getTimeMs() {
   using namespace std::chrono;
@@ -7,32 +15,315 @@ long getTimeMs() {
 }
 
 // ======================
-//     Perft Testing
+//       Perft Hash
 // ======================
 
-// Init nodes_real, used for counting
-U64 nodes_real;
+PerftHash perft_hash;
+
+/**
+ * Reallocates the perft hash to the largest power of two number of entries fitting into the given size.
+ * All stored counts are lost, size 0 disables the table. If there is not enough memory for the new table,
+ * the old one is kept.
+ *
+ * @param new_size_mb; Size of the table in megabytes.
+ * @return false if the new table could not be allocated.
+ */
+bool PerftHash::resize(U64 new_size_mb) {
+  U64 new_num_entries = 0;
+  int new_page_mode = PAGES_DEFAULT;
+  PerftHashEntry* new_entries = nullptr;
+  if (new_size_mb) {
+    U64 max_entries = new_size_mb * 1024 * 1024 / sizeof(PerftHashEntry);
+    new_num_entries = 1;
+    while (new_num_entries * 2 <= max_entries) {
+      new_num_entries *= 2;
+    }
+    try {
+      new_entries = static_cast<PerftHashEntry*>(
+          allocateLarge(new_num_entries * sizeof(PerftHashEntry), false, new_page_mode));
+    } catch (const std::bad_alloc&) {
+      clear();
+      return false;
+    }
+  }
+
+  freeLarge(entries, num_entries * sizeof(PerftHashEntry), page_mode);
+  entries = new_entries;
+  num_entries = new_num_entries;
+  size_mb = new_size_mb;
+  page_mode = new_page_mode;
+  clear();
+  return true;
+}
+
+void PerftHash::clear() {
+  for (U64 i = 0; i < num_entries; i++) {
+    entries[i].check.store(0, std::memory_order_relaxed);
+    entries[i].data.store(0, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Looks up the node count of a subtree. The same position at different depths goes to different slots.
+ *
+ * @param hash_key; Hash key of the position.
+ * @param depth; Remaining depth of the subtree.
+ * @param nodes; Set to the stored node count if the subtree was found.
+ * @return true if the subtree was found.
+ */
+bool PerftHash::probe(U64 hash_key, int depth, U64& nodes) {
+  const PerftHashEntry& slot = entries[(hash_key ^ (U64(depth) * 0x9E3779B97F4A7C15ULL)) & (num_entries - 1)];
+  U64 data = slot.data.load(std::memory_order_relaxed);
+  U64 check = slot.check.load(std::memory_order_relaxed);
+
+  if ((check ^ data) != hash_key || int(data & 0xFF) != depth) {
+    return false;
+  }
+  nodes = data >> 8;
+  return true;
+}
+
+/**
+ * Stores the node count of a subtree, replacing whatever was in its slot.
+ *
+ * @param hash_key; Hash key of the position.
+ * @param depth; Remaining depth of the subtree.
+ * @param nodes; Number of leaf nodes of the subtree.
+ */
+void PerftHash::store(U64 hash_key, int depth, U64 nodes) {
+  PerftHashEntry& slot = entries[(hash_key ^ (U64(depth) * 0x9E3779B97F4A7C15ULL)) & (num_entries - 1)];
+  U64 data = (nodes << 8) | U64(depth);
+  slot.data.store(data, std::memory_order_relaxed);
+  slot.check.store(hash_key ^ data, std::memory_order_relaxed);
+}
+
+// ======================
+//     Perft Testing
+// ======================
 
 /**
  * A recursive function that performs a performance test (Perft) for a given depth.This function is
  * used to verifythe move generation logic by comparing the number of nodes generated at a given
  * depth with known test positions (StockFish).
  *
+ * If the perft hash is enabled, the counts of subtrees at least PERFT_HASH_MIN_DEPTH deep are looked up
+ * and stored there, so transposed subtrees are only counted once. At depth 1 the legal moves are counted
+ * without making them (bulk counting).
+ *
+ * In verify mode every move down to the leaves is made and taken back and the perft hash isn't used,
+ * so make/unmake is fully exercised.
+ *
  * @param depth; The depth to which the performance test will evaluate.
- * @param game; An instance of ChessGame representing the current state of the game.
+ * @param game; An instance of ChessGame representing the current state of the game, restored before returning.
+ * @param ss; Search stack frame holding the move list and undo state of the current ply.
+ * @param verify; Make every move, also at the last ply.
+ * @return Number of leaf nodes at the given depth.
  */
-void perft(int depth, ChessGame game) {
+U64 perft(int depth, ChessGame& game, SearchStack* ss, bool verify) {
   if (depth == 0) {
-    nodes_real++;
-    return;
+    return 1;
+  }
+  U64 nodes = 0;
+  bool use_hash = !verify && depth >= PERFT_HASH_MIN_DEPTH && perft_hash.enabled();
+  if (use_hash && perft_hash.probe(game.board.hash_key, depth, nodes)) {
+    return nodes;
+  }
+
+  ss->moves.generate_moves(game.board);
+
+  // Bulk counting: the leaves are the legal moves
+  if (depth == 1 && !verify) {
+    for (int i = 0; i < ss->moves.moves_count; i++) {
+      nodes += Moves::isLegal(game.board, ss->moves.moves[i]);
+    }
+    return nodes;
+  }
+
+  for (int i = 0; i < ss->moves.moves_count; i++) {
+    game.board.saveState(ss->board_state);
+    if (!game.MakeMove(ss->moves.moves[i])) continue;
+
+    nodes += perft(depth - 1, game, ss + 1, verify);
+    game.board.restoreState(ss->board_state);
+  }
+
+  if (use_hash) {
+    perft_hash.store(game.board.hash_key, depth, nodes);
   }
+  return nodes;
+}
+
+/**
+ * Estimates the size of a perft subtree: it grows with the number of legal moves to the power of the
+ * remaining depth, the estimate is the logarithm of that. Root tasks and split tasks use the same estimate,
+ * so their sizes can be compared.
+ *
+ * @param game; Game at the root of the subtree.
+ * @param remaining_depth; Depth of the subtree.
+ * @return Estimated size, larger for larger subtrees.
+ */
+double perftTaskSize(ChessGame& game, int remaining_depth) {
+  Moves moves;
+  moves.generate_moves(game.board);
+  int legal_moves = 0;
+  for (int i = 0; i < moves.moves_count; i++) {
+    legal_moves += Moves::isLegal(game.board, moves.moves[i]);
+  }
+  return remaining_depth * std::log(1.0 + legal_moves);
+}
+
+/**
+ * Creates one perft task per legal root move, sized like the split tasks. The root moves are generated into
+ * game.moves, PerftTask::root_index indexes them.
+ *
+ * @param game; Game at the root.
+ * @param tasks; Receives the tasks.
+ * @param depth; Depth of the perft at the root.
+ */
+void perftRootTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth) {
   game.moves.generate_moves(game.board);
+  BoardState state;
   for (int i = 0; i < game.moves.moves_count; i++) {
-    game.board.copyBoard();
-    if (!game.MakeMove(game.moves.moves[i])) continue;
+    game.board.saveState(state);
+    if (!game.MakeMove(game.moves.moves[i])) {
+      // Skip illegal moves
+      // Undo is already done inside MakeMove()
+      continue;
+    }
+
+    PerftTask task;
+    task.root_index = i;
+    task.length = 1;
+    task.moves[0] = game.moves.moves[i];
+    task.size = perftTaskSize(game, depth - 1);
+    tasks.push_back(task);
+
+    game.board.restoreState(state);
+  }
+}
+
+/**
+ * Splits the perft tree into subtrees for the threads. The largest task (estimated from the number of
+ * legal moves in its position and its remaining depth) is replaced by its children until there are enough
+ * tasks. Wide positions get split deeper than narrow ones (e.g. after a check), so the tasks end up of
+ * similar size even in unbalanced trees.
+ *
+ * @param game; Game at the root, restored before returning.
+ * @param tasks; The root tasks (see perftRootTasks) on input, the split tasks on output.
+ * @param depth; Depth of the perft at the root.
+ * @param num_tasks; Wanted number of tasks.
+ */
+void splitPerftTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth, int num_tasks) {
+  SearchStack stack[PERFT_MAX_SPLIT_PLY + 1];
+
+  while (int(tasks.size()) < num_tasks) {
+    // Largest task that still has at least two plies below it
+    int largest = -1;
+    for (int i = 0; i < int(tasks.size()); i++) {
+      bool can_split = tasks[i].length < PERFT_MAX_SPLIT_PLY && depth - tasks[i].length >= 2;
+      if (can_split && (largest < 0 || tasks[i].size > tasks[largest].size)) {
+        largest = i;
+      }
+    }
+    if (largest < 0) {
+      break;
+    }
+    PerftTask parent = tasks[largest];
+    tasks.erase(tasks.begin() + largest);
+
+    // Play the moves leading to the task and replace it with one task per legal move
+    for (int ply = 0; ply < parent.length; ply++) {
+      game.board.saveState(stack[ply].board_state);
+      game.MakeMove(parent.moves[ply]);
+    }
+    Moves& moves = stack[parent.length].moves;
+    moves.generate_moves(game.board);
+    for (int i = 0; i < moves.moves_count; i++) {
+      game.board.saveState(stack[parent.length].board_state);
+      if (!game.MakeMove(moves.moves[i])) continue;
+
+      PerftTask child = parent;
+      child.moves[child.length++] = moves.moves[i];
+
+      child.size = perftTaskSize(game, depth - child.length);
+      tasks.push_back(child);
 
-    perft(depth - 1, game);
-    game.board.revertBoard();
+      game.board.restoreState(stack[parent.length].board_state);
+    }
+    for (int ply = parent.length - 1; ply >= 0; ply--) {
+      game.board.restoreState(stack[ply].board_state);
+    }
+  }
+}
+
+/**
+ * Counts the perft subtrees of the tasks on several threads. The tasks are dealt out to per-thread queues,
+ * largest first. A thread takes the next task from the front of its own queue and, once it runs dry, steals
+ * from the back of the other queues. Every thread has its own copy of the game and its own node counters.
+ * The threads come from the search thread pool.
+ *
+ * @param game; Game at the root.
+ * @param tasks; Subtrees to be counted.
+ * @param depth; Depth of the perft at the root.
+ * @param num_threads; Number of threads.
+ * @param verify; Make every move, also at the last ply (see perft).
+ * @param root_nodes; Node counts of the root moves, indexed by PerftTask::root_index. Counts are added to it.
+ */
+void runPerftTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth, int num_threads, bool verify,
+                   U64* root_nodes) {
+  std::stable_sort(tasks.begin(), tasks.end(), [](const PerftTask& a, const PerftTask& b) { return a.size > b.size; });
+
+  std::vector<std::deque<PerftTask>> queues(num_threads);
+  std::vector<std::mutex> queue_mutexes(num_threads);
+  for (int i = 0; i < int(tasks.size()); i++) {
+    queues[i % num_threads].push_back(tasks[i]);
+  }
+
+  std::vector<std::vector<U64>> thread_nodes(num_threads, std::vector<U64>(256, 0));
+
+  auto worker = [&](int thread_id) {
+    ChessGame thread_game = game;
+    std::vector<SearchStack> stack(MAX_PLY);
+
+    while (true) {
+      // Own queue first, then steal from the others
+      PerftTask task;
+      bool found = false;
+      for (int offset = 0; offset < num_threads && !found; offset++) {
+        int victim = (thread_id + offset) % num_threads;
+        std::lock_guard<std::mutex> lock(queue_mutexes[victim]);
+        if (queues[victim].empty()) continue;
+
+        if (victim == thread_id) {
+          task = queues[victim].front();
+          queues[victim].pop_front();
+        } else {
+          task = queues[victim].back();
+          queues[victim].pop_back();
+        }
+        found = true;
+      }
+      if (!found) {
+        return;
+      }
+
+      for (int ply = 0; ply < task.length; ply++) {
+        thread_game.board.saveState(stack[ply].board_state);
+        thread_game.MakeMove(task.moves[ply]);
+      }
+      thread_nodes[thread_id][task.root_index] += perft(depth - task.length, thread_game, &stack[task.length], verify);
+      for (int ply = task.length - 1; ply >= 0; ply--) {
+        thread_game.board.restoreState(stack[ply].board_state);
+      }
+    }
+  };
+
+  threads.run(worker, num_threads);
+
+  for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+    for (int i = 0; i < 256; i++) {
+      root_nodes[i] += thread_nodes[thread_id][i];
+    }
   }
 }
 
@@ -42,15 +333,20 @@ void perft(int depth, ChessGame game) {
  * of leaf nodes each move generates. It supports both console and file output for reviewing the
  * results.
  *
+ * With more than one thread the tree is split into subtrees (see splitPerftTasks) counted in parallel,
+ * the output is the same.
+ *
  * @param depth; The depth to which the performance test will evaluate.
  * @param game; A reference to an instance of ChessGame, representing the current game state.
+ * @param num_threads; Number of threads counting the nodes.
+ * @param verify; Make every move, also at the last ply (see perft).
  */
-void perftTest(int depth, ChessGame& game) {
+void perftTest(int depth, ChessGame& game, int num_threads, bool verify) {
   std::ofstream outFile;  // Declare the ofstream object for file output
 
   // Check if file output is enabled and open the results file
   if (game.file_output) {
-    outFile.open(".\\test\\results_lb.txt", std::ios::app);  // Open and clear contents
+    outFile.open(OUTPUT_FILE_LB, std::ios::app);  // Open and clear contents
     if (!outFile) {
       std::cerr << "Failed to open output file results_lb.txt" << std::endl;
       return;
@@ -63,68 +359,171 @@ void perftTest(int depth, ChessGame& game) {
     std::cout << "\n     Perft performance test\n\n" << std::endl;
   }
 
-  // Log the depth being tested
-  game.moves.generate_moves(game.board);
-  long cummulative_nodes = 0;
-  long old_nodes = 0;
-  U64 nodes = 0;
-
   // Record start time for the test
   long start = getTimeMs();
 
-  // Loop over all generated moves at the current level
-  for (int i = 0; i < game.moves.moves_count; i++) {
-    // Preserve board state
-    game.board.copyBoard();
-
-    if (!game.MakeMove(game.moves.moves[i])) {
-      // Skip illegal moves
-      // Undo is already done inside MakeMove()
-      continue;
-    }
-
-    // Track nodes before making the move
-    cummulative_nodes = nodes_real;
-
-    // Call perft driver recursively
-    perft(depth - 1, game);
+  // One task per legal root move, the subtrees are split further for more threads
+  std::vector<PerftTask> tasks;
+  perftRootTasks(game, tasks, depth);
+  std::vector<int> root_moves;
+  for (const PerftTask& task : tasks) {
+    root_moves.push_back(task.root_index);
+  }
 
-    // Calculate nodes generated by this move
-    old_nodes = nodes_real - cummulative_nodes;
+  if (num_threads > 1) {
+    splitPerftTasks(game, tasks, depth, num_threads * PERFT_TASKS_PER_THREAD);
+  }
+  U64 root_nodes[256] = {};
+  runPerftTasks(game, tasks, depth, num_threads, verify, root_nodes);
 
-    // Revert to previous state (Undo move)
-    game.board.revertBoard();
+  U64 nodes = 0;
+  for (int i : root_moves) {
+    int move = game.moves.moves[i];
+    nodes += root_nodes[i];
 
     // Output move and node count to either file or console
     if (game.file_output) {
-      outFile << square_to_position[game.moves.get_move_source(game.moves.moves[i])]
-              << square_to_position[game.moves.get_move_target(game.moves.moves[i])];
-      if (game.moves.get_move_promoted(game.moves.moves[i])) {
-        outFile << ASCII_PIECES_LOWER[game.moves.get_move_promoted(game.moves.moves[i])];
+      outFile << square_to_position[game.moves.get_move_source(move)]
+              << square_to_position[game.moves.get_move_target(move)];
+      if (game.moves.get_move_promoted(move)) {
+        outFile << ASCII_PIECES_LOWER[game.moves.get_move_promoted(move)];
       }
-      outFile << ": " << old_nodes << '\n';
+      outFile << ": " << root_nodes[i] << '\n';
 
     } else {
-      std::cout << square_to_position[game.moves.get_move_source(game.moves.moves[i])]
-                << square_to_position[game.moves.get_move_target(game.moves.moves[i])];
+      std::cout << square_to_position[game.moves.get_move_source(move)]
+                << square_to_position[game.moves.get_move_target(move)];
 
-      if (game.moves.get_move_promoted(game.moves.moves[i])) {
-        std::cout << ASCII_PIECES_LOWER[game.moves.get_move_promoted(game.moves.moves[i])];
+      if (game.moves.get_move_promoted(move)) {
+        std::cout << ASCII_PIECES_LOWER[game.moves.get_move_promoted(move)];
       }
-      std::cout << ": " << old_nodes << '\n';
+      std::cout << ": " << root_nodes[i] << '\n';
     }
   }
 
   // Print final results
   if (game.file_output) {
-    outFile << "Nodes searched: " << nodes_real << "\n";
+    outFile << "Nodes searched: " << nodes << "\n";
 
   } else {
     std::cout << "\n       Depth: " << depth << '\n'
-              << "Nodes searched: " << nodes_real << '\n'
+              << "Nodes searched: " << nodes << '\n'
               << "          Time: " << (getTimeMs() - start) << " ms\n\n";
   }
+}
+
+/**
+ * Classifies a legal leaf move for the perft statistics: makes it, finds the pieces giving check and
+ * looks for a legal reply when in check. A check is discovered if only pieces other than the moved one
+ * (the rook when castling) give it. A double check by the moved piece and another one is not discovered.
+ *
+ * @param game; Current state of the chess game, restored before returning.
+ * @param ss; Search stack frame of the leaf's parent, the next frame holds the replies.
+ * @param move; Legal move leading to the leaf.
+ * @param stats; Statistics the leaf is added to.
+ */
+void addLeafStats(ChessGame& game, SearchStack* ss, int move, PerftStats& stats) {
+  int to_square = Moves::get_move_target(move);
+  stats.nodes++;
+  stats.captures += Moves::get_move_capture(move) != 0;
+  stats.enpassants += Moves::get_move_enpassant(move) != 0;
+  stats.castles += Moves::get_move_castling(move) != 0;
+  stats.promotions += Moves::get_move_promoted(move) != 0;
+
+  game.board.saveState(ss->board_state);
+  game.MakeMove(move);
+
+  int color = game.board.color;
+  int king_square = bitScanForward(game.board.bitboards[color == white ? WK : BK]);
+  U64 checkers = game.board.attackersTo(king_square, game.board.occupancy[both]) & game.board.occupancy[color ^ 1];
+
+  if (checkers) {
+    // Squares of the pieces that moved: the piece itself, and the rook when castling
+    U64 moved = 1ULL << to_square;
+    if (Moves::get_move_castling(move)) {
+      moved |= 1ULL << ((to_square > Moves::get_move_source(move)) ? to_square - 1 : to_square + 1);
+    }
+    stats.checks++;
+    stats.discovered_checks += !(checkers & moved);
+    stats.double_checks += countBits(checkers) > 1;
+
+    Moves& replies = (ss + 1)->moves;
+    replies.generate_moves(game.board);
+    bool has_reply = false;
+    for (int i = 0; i < replies.moves_count && !has_reply; i++) {
+      has_reply = Moves::isLegal(game.board, replies.moves[i]);
+    }
+    stats.checkmates += !has_reply;
+  }
+
+  game.board.restoreState(ss->board_state);
+}
+
+/**
+ * Perft that also classifies the leaf nodes (see PerftStats). Every move is made, like in verify mode.
+ *
+ * @param depth; Remaining depth, at least 1.
+ * @param game; Current state of the chess game, restored before returning.
+ * @param ss; Search stack frame holding the move list and undo state of the current ply.
+ * @param stats; Statistics the leaves are added to.
+ */
+void perftStats(int depth, ChessGame& game, SearchStack* ss, PerftStats& stats) {
+  ss->moves.generate_moves(game.board);
+  for (int i = 0; i < ss->moves.moves_count; i++) {
+    int move = ss->moves.moves[i];
+    if (depth == 1) {
+      if (Moves::isLegal(game.board, move)) {
+        addLeafStats(game, ss, move, stats);
+      }
+      continue;
+    }
+
+    game.board.saveState(ss->board_state);
+    if (!game.MakeMove(move)) continue;
+
+    perftStats(depth - 1, game, ss + 1, stats);
+    game.board.restoreState(ss->board_state);
+  }
+}
 
-  // Reset the node counter for the next test
-  nodes_real = 0ULL;
+/**
+ * Runs a detailed perft for every depth from 1 to the given one and prints the leaf statistics as a table
+ * (laid out like the published perft tables) and as a JSON line, so a wrong move type stands out.
+ *
+ * @param depth; Deepest depth to be tested.
+ * @param game; A reference to an instance of ChessGame, representing the current game state.
+ */
+void perftStatsTest(int depth, ChessGame& game) {
+  std::vector<PerftStats> results;
+  SearchStack stack[MAX_PLY];
+
+  long start = getTimeMs();
+  for (int curr_depth = 1; curr_depth <= depth; curr_depth++) {
+    PerftStats stats = {};
+    perftStats(curr_depth, game, stack, stats);
+    results.push_back(stats);
+  }
+
+  std::cout << "\n     Perft statistics\n\n";
+  printf("%5s %14s %12s %10s %10s %10s %12s %10s %10s %10s\n", "Depth", "Nodes", "Captures", "E.p.", "Castles",
+         "Promotions", "Checks", "Disc.Chk", "Dbl.Chk", "Mates");
+  for (int i = 0; i < int(results.size()); i++) {
+    const PerftStats& stats = results[i];
+    printf("%5d %14llu %12llu %10llu %10llu %10llu %12llu %10llu %10llu %10llu\n", i + 1,
+           (unsigned long long)stats.nodes, (unsigned long long)stats.captures, (unsigned long long)stats.enpassants,
+           (unsigned long long)stats.castles, (unsigned long long)stats.promotions, (unsigned long long)stats.checks,
+           (unsigned long long)stats.discovered_checks, (unsigned long long)stats.double_checks,
+           (unsigned long long)stats.checkmates);
+  }
+
+  std::cout << "\n[";
+  for (int i = 0; i < int(results.size()); i++) {
+    const PerftStats& stats = results[i];
+    std::cout << (i ? "," : "") << "{\"depth\":" << i + 1 << ",\"nodes\":" << stats.nodes
+              << ",\"captures\":" << stats.captures << ",\"enpassants\":" << stats.enpassants
+              << ",\"castles\":" << stats.castles << ",\"promotions\":" << stats.promotions
+              << ",\"checks\":" << stats.checks << ",\"discovered_checks\":" << stats.discovered_checks
+              << ",\"double_checks\":" << stats.double_checks << ",\"checkmates\":" << stats.checkmates << "}";
+  }
+  std::cout << "]\n\n          Time: " << (getTimeMs() - start) << " ms\n\n";
 }
@@ -1,16 +1,96 @@
 #ifndef PERFT_H_
 #define PERFT_H_
 
+#include <atomic>
 #include <fstream>
+#include <vector>
 
 #include "./chess_game.h"
 #include "./chess_utils.h"
+#include "./large_pages.h"
+#include "./search_stack.h"
 
 class ChessGame;
 
+// Parallel perft: the tree is split into at least this many subtrees per thread (if it is deep enough)
+const int PERFT_TASKS_PER_THREAD = 16;
+// Parallel perft: subtrees start at most this many plies below the root
+const int PERFT_MAX_SPLIT_PLY = 6;
+
+// Perft hash: shallower subtrees are cheaper to count than to look up
+const int PERFT_HASH_MIN_DEPTH = 2;
+
+// Subtree counted by one thread of a parallel perft
+struct PerftTask {
+  int root_index;                  // Index of the root move the subtree belongs to
+  int length;                      // Number of moves from the root to the subtree
+  int moves[PERFT_MAX_SPLIT_PLY];  // Moves from the root to the subtree
+  double size;                     // Estimated size of the subtree, larger ones are split first
+};
+
+/**
+ * Perft hash entry (16 bytes). The node count and depth are packed into data, check holds the position's hash
+ * key xored with data. An entry torn by two threads writing at once fails the check, so no locks are needed.
+ */
+struct PerftHashEntry {
+  std::atomic<U64> check;  // Hash key ^ data
+  std::atomic<U64> data;   // Node count << 8 | depth
+};
+
+/**
+ * Node counts of perft subtrees, keyed by the position's hash key and the remaining depth. Transposed
+ * subtrees are counted only once. Disabled (size 0) by default, shared by all perft threads.
+ */
+class PerftHash {
+  PerftHashEntry* entries = nullptr;
+  U64 num_entries = 0;
+  U64 size_mb = 0;
+  int page_mode = PAGES_DEFAULT;
+
+ public:
+  ~PerftHash() { freeLarge(entries, num_entries * sizeof(PerftHashEntry), page_mode); }
+
+  // --- Table Management ---
+  bool resize(U64 new_size_mb);
+  void clear();
+  bool enabled() const { return num_entries != 0; }
+  U64 sizeMb() const { return size_mb; }
+  const char* pageMode() const { return pageModeName(page_mode); }
+
+  // --- Probing ---
+  bool probe(U64 hash_key, int depth, U64& nodes);
+  void store(U64 hash_key, int depth, U64 nodes);
+
+  static constexpr U64 MAX_SIZE_MB = 65536;
+};
+
+// Perft hash shared by all perft threads (UCI option PerftHash)
+extern PerftHash perft_hash;
+
+// Leaf node counts of a perft by move type, as in the published perft tables
+struct PerftStats {
+  U64 nodes;
+  U64 captures;  // Including en passant captures
+  U64 enpassants;
+  U64 castles;
+  U64 promotions;
+  U64 checks;             // Including discovered and double checks
+  U64 discovered_checks;  // Given only by pieces that didn't move
+  U64 double_checks;
+  U64 checkmates;
+};
+
 long getTimeMs();
 
-void perft(int depth, ChessGame game);
-void perftTest(int depth, ChessGame& game);
+U64 perft(int depth, ChessGame& game, SearchStack* ss, bool verify);
+double perftTaskSize(ChessGame& game, int remaining_depth);
+void perftRootTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth);
+void splitPerftTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth, int num_tasks);
+void runPerftTasks(ChessGame& game, std::vector<PerftTask>& tasks, int depth, int num_threads, bool verify,
+                   U64* root_nodes);
+void perftTest(int depth, ChessGame& game, int num_threads, bool verify);
+void addLeafStats(ChessGame& game, SearchStack* ss, int move, PerftStats& stats);
+void perftStats(int depth, ChessGame& game, SearchStack* ss, PerftStats& stats);
+void perftStatsTest(int depth, ChessGame& game);
 
-#endif  // PERFT_H_
\ No newline at end of file
+#endif  // PERFT_H_
@@ -0,0 +1,38 @@
+#ifndef SEARCH_STACK_H_
+#define SEARCH_STACK_H_
+
+#include "./chess_board.h"
+#include "./chess_moves.h"
+#include "./chess_utils.h"
+
+// Maximum distance from the root in plies, including extensions and quiescence search
+const int MAX_PLY = 128;
+
+// Maximum depth of an iterative deepening search, leaves room below it for extensions and quiescence search
+const int MAX_DEPTH = 100;
+
+// Static evaluation of a node that wasn't evaluated (side to move in check)
+const int NO_EVAL = -100000;
+
+// Frames in front of the root frame, so heuristics can look back two plies without bounds checks
+const int SEARCH_STACK_OFFSET = 2;
+
+// Frames of a search stack: the ones in front of the root, one per ply and two more for (ss + 2) at the last ply
+const int SEARCH_STACK_SIZE = MAX_PLY + SEARCH_STACK_OFFSET + 2;
+
+/**
+ * Search data of a single ply. The search uses one preallocated array of frames and passes a pointer
+ * to the next frame down the recursion, instead of copying the whole game state at every node.
+ * Frames are cache line aligned so neighbouring plies don't share lines.
+ */
+struct alignas(64) SearchStack {
+  Moves moves;             // Move list of the node
+  BoardState board_state;  // Board before current_move was made, used to undo it
+  int static_eval;         // Static evaluation of the node (NO_EVAL when in check)
+  int current_move;        // Move currently searched from this node
+  int killers[2];          // Quiet moves that caused a beta cutoff at this ply
+  int reduction;           // Reduction (LMR) applied to current_move
+  int excluded_move;       // Move skipped by the singular extension search of the node
+};
+
+#endif  // SEARCH_STACK_H_
@@ -0,0 +1,119 @@
+#include "./thread_pool.h"
+
+#include "./numa.h"
+
+ThreadPool threads;
+
+// =================================
+//         Pool Management
+// =================================
+
+/**
+ * Changes the number of search threads. Only the helpers beyond the smaller of the two sizes are stopped or
+ * started, the others keep running with their thread local data (e.g. history tables) and NUMA binding.
+ * On NUMA machines every thread (also the calling one) is bound to a node, a single calling thread gets its
+ * original CPUs back.
+ *
+ * @param num_threads; Number of search threads, including the calling thread.
+ */
+void ThreadPool::resize(int num_threads) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    wanted_size = num_threads;
+  }
+  start_condition.notify_all();
+  while (size() > num_threads) {
+    helpers.back().join();
+    helpers.pop_back();
+  }
+
+  // The calling thread is only bound while it shares the search with helpers
+  if (num_threads > 1) {
+    bindThreadToNode(0);
+  } else {
+    unbindThread();
+  }
+  for (int thread_id = size(); thread_id < num_threads; thread_id++) {
+    helpers.emplace_back(&ThreadPool::helperLoop, this, thread_id, generation);
+  }
+}
+
+/**
+ * Main loop of a helper thread: waits for a job, runs it and reports back, until the pool shrinks below it.
+ *
+ * @param thread_id; Index of the thread in the pool (1 and up).
+ * @param last_generation; Generation of the last job run before the thread was started.
+ */
+void ThreadPool::helperLoop(int thread_id, U64 last_generation) {
+  bindThreadToNode(thread_id);
+
+  while (true) {
+    std::function<void(int)> current_job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      start_condition.wait(lock, [&] { return thread_id >= wanted_size || generation != last_generation; });
+      if (thread_id >= wanted_size) {
+        return;
+      }
+      last_generation = generation;
+      current_job = job;
+    }
+
+    current_job(thread_id);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pending == 0) {
+      done_condition.notify_one();
+    }
+  }
+}
+
+// =================================
+//               Jobs
+// =================================
+
+/**
+ * Runs a job on all threads of the pool and waits until every thread has finished it.
+ *
+ * @param new_job; Function called with the index of the thread running it (0 for the calling thread).
+ */
+void ThreadPool::run(const std::function<void(int)>& new_job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = new_job;
+    pending = int(helpers.size());
+    generation++;
+  }
+  start_condition.notify_all();
+
+  new_job(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done_condition.wait(lock, [&] { return pending == 0; });
+}
+
+/**
+ * Runs a job on the first num_threads threads of the pool (clamped to [1, MAX_THREADS]) and waits until they
+ * have finished it. If the pool is smaller, the missing helpers are started for the job and stopped afterwards,
+ * so jobs outside the search don't change the Threads option. The helpers of the pool keep running.
+ *
+ * @param new_job; Function called with the index of the thread running it (0 for the calling thread).
+ * @param num_threads; Number of threads running the job.
+ */
+void ThreadPool::run(const std::function<void(int)>& new_job, int num_threads) {
+  num_threads = std::max(1, std::min(num_threads, MAX_THREADS));
+  int pool_size = size();
+  if (num_threads > pool_size) {
+    resize(num_threads);
+  }
+
+  run([&](int thread_id) {
+    if (thread_id < num_threads) {
+      new_job(thread_id);
+    }
+  });
+
+  if (size() != pool_size) {
+    resize(pool_size);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./chess_utils.h"
+
+/**
+ * Search threads. The helper threads are started once and sleep between jobs, so their thread local
+ * search data (history tables, node counters) lives as long as the pool. A job runs on all threads at once,
+ * the calling thread is thread 0.
+ */
+class ThreadPool {
+  std::vector<std::thread> helpers;
+  std::mutex mutex;
+  std::condition_variable start_condition;
+  std::condition_variable done_condition;
+  std::function<void(int)> job;
+  U64 generation = 0;  // Incremented for every job, wakes up the helpers
+  int pending = 0;     // Helpers still running the current job
+  int wanted_size = 1;  // Size the pool is resized to, helpers with a larger index exit
+
+  void helperLoop(int thread_id, U64 last_generation);
+
+ public:
+  ~ThreadPool() { resize(1); }
+
+  // --- Pool Management ---
+  void resize(int num_threads);
+  int size() const { return int(helpers.size()) + 1; }
+
+  // --- Jobs ---
+  void run(const std::function<void(int)>& new_job);
+  void run(const std::function<void(int)>& new_job, int num_threads);
+
+  static constexpr int MAX_THREADS = 64;
+};
+
+// Search threads shared by all searches
+extern ThreadPool threads;
+
+#endif  // THREAD_POOL_H_
@@ -0,0 +1,132 @@
+#include "./transposition_table.h"
+
+#include <new>
+
+#include "./thread_pool.h"
+
+TranspositionTable tt;
+
+// =================================
+//         Table Management
+// =================================
+
+/**
+ * Allocates the table with the largest power of two number of entries fitting into the given size,
+ * so the slot of a position can be selected with a mask. The table is backed by huge pages where possible,
+ * since probes hit random slots. The entries are not initialized. The new table is allocated before the
+ * old one is released, so if there is not enough memory the old table stays in place.
+ *
+ * @param new_size_mb; Size of the table in megabytes.
+ * @return false if the new table could not be allocated.
+ */
+bool TranspositionTable::allocate(U64 new_size_mb) {
+  U64 max_entries = new_size_mb * 1024 * 1024 / sizeof(TTSlot);
+  U64 new_num_entries = 1;
+  while (new_num_entries * 2 <= max_entries) {
+    new_num_entries *= 2;
+  }
+
+  int new_page_mode;
+  TTSlot* new_entries;
+  try {
+    new_entries = static_cast<TTSlot*>(allocateLarge(new_num_entries * sizeof(TTSlot), use_hugetlb, new_page_mode));
+  } catch (const std::bad_alloc&) {
+    return false;
+  }
+
+  freeLarge(entries, num_entries * sizeof(TTSlot), page_mode);
+  entries = new_entries;
+  num_entries = new_num_entries;
+  size_mb = new_size_mb;
+  page_mode = new_page_mode;
+  return true;
+}
+
+/**
+ * Reallocates and clears the table. All stored entries are lost, also if the allocation fails and
+ * the table keeps its old size.
+ *
+ * @param new_size_mb; Size of the table in megabytes.
+ * @return false if the table could not be allocated and kept its old size.
+ */
+bool TranspositionTable::resize(U64 new_size_mb) {
+  bool allocated = allocate(new_size_mb);
+  clear();
+  return allocated;
+}
+
+/**
+ * Clears the table. Every search thread clears its own slice, so in a freshly allocated table the pages
+ * are first touched (and placed by the OS) on the NUMA nodes of the threads that clear them.
+ */
+void TranspositionTable::clear() {
+  int num_threads = threads.size();
+  threads.run([&](int thread_id) {
+    U64 begin = num_entries * thread_id / num_threads;
+    U64 end = num_entries * (thread_id + 1) / num_threads;
+    clearSlots(begin, end);
+  });
+}
+
+// Empties the slots in [begin, end)
+void TranspositionTable::clearSlots(U64 begin, U64 end) {
+  for (U64 i = begin; i < end; i++) {
+    entries[i].check.store(0, std::memory_order_relaxed);
+    entries[i].data.store(0, std::memory_order_relaxed);
+  }
+}
+
+// =================================
+//             Probing
+// =================================
+
+/**
+ * Looks up a position in the table.
+ *
+ * @param hash_key; Hash key of the position.
+ * @param entry; Filled with the stored entry if the position was found.
+ * @return true if the position was found.
+ */
+bool TranspositionTable::probe(U64 hash_key, TTEntry& entry) {
+  const TTSlot& slot = entries[hash_key & (num_entries - 1)];
+  U64 data = slot.data.load(std::memory_order_relaxed);
+  U64 check = slot.check.load(std::memory_order_relaxed);
+
+  entry.flag = int(data >> 56);
+  if (entry.flag == TT_NONE || (check ^ data) != hash_key) {
+    return false;
+  }
+  entry.move = int(data & 0xFFFFFF);
+  entry.score = int(int32_t(uint32_t(data >> 16) & 0xFFFFFF00) >> 8);  // Sign extended from 24 bits
+  entry.depth = int((data >> 48) & 0xFF);
+  return true;
+}
+
+/**
+ * Stores the search result of a position, replacing whatever was in its slot. A missing best move
+ * doesn't overwrite the move already stored for the same position. Nothing is stored while the table is
+ * read only.
+ *
+ * @param hash_key; Hash key of the position.
+ * @param move; Best move found (0 if none).
+ * @param score; Score of the position, already adjusted for mate distance.
+ * @param depth; Remaining depth of the search.
+ * @param flag; TT_EXACT, TT_LOWER or TT_UPPER.
+ */
+void TranspositionTable::store(U64 hash_key, int move, int score, int depth, int flag) {
+  if (read_only) {
+    return;
+  }
+
+  TTSlot& slot = entries[hash_key & (num_entries - 1)];
+  if (!move) {
+    U64 old_data = slot.data.load(std::memory_order_relaxed);
+    if ((slot.check.load(std::memory_order_relaxed) ^ old_data) == hash_key) {
+      move = int(old_data & 0xFFFFFF);
+    }
+  }
+
+  U64 data = U64(flag) << 56 | U64(depth & 0xFF) << 48 | U64(uint32_t(score) & 0xFFFFFF) << 24 | U64(move & 0xFFFFFF);
+  slot.data.store(data, std::memory_order_relaxed);
+  slot.check.store(hash_key ^ data, std::memory_order_relaxed);
+}
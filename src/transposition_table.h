@@ -0,0 +1,69 @@
+#ifndef TRANSPOSITION_TABLE_H_
+#define TRANSPOSITION_TABLE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "./chess_utils.h"
+#include "./large_pages.h"
+
+// Type of the score stored in a transposition table entry
+enum { TT_NONE, TT_EXACT, TT_LOWER, TT_UPPER };
+
+// Transposition table entry, as returned by a probe
+struct TTEntry {
+  int move;   // Best move found in the position (0 if none)
+  int score;  // Exact score or bound, mate scores relative to the position
+  int depth;  // Remaining depth the position was searched to
+  int flag;   // TT_EXACT, TT_LOWER (fail high) or TT_UPPER (fail low)
+};
+
+/**
+ * Slot of the transposition table (16 bytes), shared by all search threads without locks. The entry is
+ * packed into data, check holds the position's hash key xor data. A slot torn by two threads writing it
+ * at once no longer verifies against any key, so it is a miss instead of a wrong entry.
+ */
+struct TTSlot {
+  std::atomic<U64> check;  // Hash key ^ data
+  std::atomic<U64> data;   // Flag << 56 | depth << 48 | (score & 0xFFFFFF) << 24 | move
+};
+
+class TranspositionTable {
+  TTSlot* entries = nullptr;
+  U64 num_entries = 0;
+  U64 size_mb = 0;
+  bool read_only = false;    // Stores are ignored, set while threads search in deterministic mode
+  bool use_hugetlb = false;  // Try explicit huge pages when allocating (UCI option LargePages)
+  int page_mode = PAGES_DEFAULT;
+
+  bool allocate(U64 new_size_mb);
+  void clearSlots(U64 begin, U64 end);
+
+ public:
+  // The search threads don't exist yet at startup, the calling thread clears the whole table
+  TranspositionTable() {
+    allocate(DEFAULT_SIZE_MB);
+    clearSlots(0, num_entries);
+  }
+  ~TranspositionTable() { freeLarge(entries, num_entries * sizeof(TTSlot), page_mode); }
+
+  // --- Table Management ---
+  bool resize(U64 new_size_mb);
+  void clear();
+  U64 sizeMb() const { return size_mb; }
+  void setHugeTLB(bool value) { use_hugetlb = value; }
+  const char* pageMode() const { return pageModeName(page_mode); }
+  void setReadOnly(bool value) { read_only = value; }
+
+  // --- Probing ---
+  bool probe(U64 hash_key, TTEntry& entry);
+  void store(U64 hash_key, int move, int score, int depth, int flag);
+
+  static constexpr U64 DEFAULT_SIZE_MB = 64;
+  static constexpr U64 MAX_SIZE_MB = 65536;
+};
+
+// Transposition table shared by all searches
+extern TranspositionTable tt;
+
+#endif  // TRANSPOSITION_TABLE_H_